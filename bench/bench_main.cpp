@@ -0,0 +1,7 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <benchmark/benchmark.h>
+
+BENCHMARK_MAIN();
@@ -0,0 +1,134 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_BENCH_ROM_H
+#define NES_CPP_BENCH_ROM_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+namespace nes::bench {
+
+    // Write a NROM-128 image with code at $8000 and every vector pointing to entry, return its path.
+    inline std::filesystem::path make_rom(std::string_view name, std::vector<uint8_t> const &code,
+                                          uint16_t entry = 0x8000) {
+        std::vector<uint8_t> prg(0x4000, 0xea);
+        std::copy(code.begin(), code.end(), prg.begin());
+        for (auto vector : {0x3ffa, 0x3ffc, 0x3ffe}) {
+            prg[vector] = entry & 0xffu;
+            prg[vector + 1] = entry >> 8u;
+        }
+
+        auto path = std::filesystem::temp_directory_path() / (std::string(name) + ".nes");
+        std::ofstream file(path, std::ios::binary);
+        uint8_t header[16]{'N', 'E', 'S', 0x1a, 1, 1};
+        file.write(reinterpret_cast<char const *>(header), sizeof(header));
+        file.write(reinterpret_cast<char const *>(prg.data()), static_cast<std::streamsize>(prg.size()));
+        std::vector<char> chr(0x2000, 0);
+        file.write(chr.data(), static_cast<std::streamsize>(chr.size()));
+
+        return path;
+    }
+
+    // $8000: a few instructions looping forever
+    inline std::vector<uint8_t> const dex_loop{
+            0xa2, 0x00,             // LDX #0
+            0xca,                   // loop: DEX
+            0xd0, 0xfd,             // BNE loop
+            0x4c, 0x00, 0x80,       // JMP $8000
+    };
+
+    inline std::vector<uint8_t> const alu_loop{
+            0x18,                   // CLC
+            0xa9, 0x01,             // LDA #1
+            0x69, 0x03,             // loop: ADC #3
+            0x49, 0x55,             // EOR #$55
+            0x0a,                   // ASL A
+            0x6a,                   // ROR A
+            0x29, 0x7f,             // AND #$7f
+            0x09, 0x01,             // ORA #1
+            0xc9, 0x40,             // CMP #$40
+            0xe8,                   // INX
+            0xd0, 0xf1,             // BNE loop
+            0x4c, 0x00, 0x80,       // JMP $8000
+    };
+
+    inline std::vector<uint8_t> const copy_loop{
+            0xa2, 0x00,             // LDX #0
+            0xbd, 0x00, 0x03,       // loop: LDA $0300,X
+            0x9d, 0x00, 0x04,       // STA $0400,X
+            0xe8,                   // INX
+            0xd0, 0xf7,             // BNE loop
+            0xa9, 0x00,             // LDA #0
+            0x85, 0x10,             // STA $10
+            0xa9, 0x05,             // LDA #5
+            0x85, 0x11,             // STA $11
+            0xa0, 0x00,             // LDY #0
+            0xb1, 0x10,             // loop2: LDA ($10),Y
+            0x91, 0x10,             // STA ($10),Y
+            0xc8,                   // INY
+            0xd0, 0xf9,             // BNE loop2
+            0x4c, 0x00, 0x80,       // JMP $8000
+    };
+
+    inline std::vector<uint8_t> const call_loop{
+            0x20, 0x06, 0x80,       // JSR sub
+            0x4c, 0x00, 0x80,       // JMP $8000
+            0x48,                   // sub: PHA
+            0xe6, 0x20,             // INC $20
+            0x68,                   // PLA
+            0x60,                   // RTS
+    };
+
+    // A small homebrew "game loop": moves 64 objects bouncing on the screen edge every frame and sums
+    // their positions. Entry point is the init routine at $8040.
+    inline std::vector<uint8_t> homebrew() {
+        std::vector<uint8_t> code{
+                0xa2, 0x3f,             // frame: LDX #63
+                0xbd, 0x00, 0x02,       // obj: LDA $0200,X
+                0x18,                   // CLC
+                0x7d, 0x40, 0x02,       // ADC $0240,X
+                0x9d, 0x00, 0x02,       // STA $0200,X
+                0xc9, 0xf0,             // CMP #$f0
+                0x90, 0x0b,             // BCC next
+                0xbd, 0x40, 0x02,       // LDA $0240,X
+                0x49, 0xff,             // EOR #$ff
+                0x18,                   // CLC
+                0x69, 0x01,             // ADC #1
+                0x9d, 0x40, 0x02,       // STA $0240,X
+                0xca,                   // next: DEX
+                0x10, 0xe4,             // BPL obj
+                0xa9, 0x00,             // LDA #0
+                0xa0, 0x3f,             // LDY #63
+                0x18,                   // sum: CLC
+                0x79, 0x00, 0x02,       // ADC $0200,Y
+                0x88,                   // DEY
+                0x10, 0xf9,             // BPL sum
+                0x85, 0x10,             // STA $10
+                0xe6, 0x11,             // INC $11
+                0x4c, 0x00, 0x80,       // JMP frame
+        };
+        code.resize(0x40, 0xea);
+        code.insert(code.end(), {
+                0x78,                   // init: SEI
+                0xd8,                   // CLD
+                0xa2, 0xff,             // LDX #$ff
+                0x9a,                   // TXS
+                0xa2, 0x3f,             // LDX #63
+                0x8a,                   // speed: TXA
+                0x29, 0x07,             // AND #7
+                0x09, 0x01,             // ORA #1
+                0x9d, 0x40, 0x02,       // STA $0240,X
+                0xca,                   // DEX
+                0x10, 0xf5,             // BPL speed
+                0x4c, 0x00, 0x80,       // JMP frame
+        });
+        return code;
+    }
+}
+
+#endif //NES_CPP_BENCH_ROM_H
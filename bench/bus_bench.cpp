@@ -0,0 +1,98 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <benchmark/benchmark.h>
+
+#include "core/console.h"
+#include "memory/block.h"
+#include "bench_rom.h"
+
+using namespace nes;
+
+// range(0) is the base address of the region: internal ram, ram mirror, prg-ram, prg-rom
+static void BM_bus_fetch_u8(benchmark::State &state) {
+    auto console = core::console(bench::make_rom("bus", bench::dex_loop));
+    auto &membus = console.membus();
+    auto base = static_cast<uint16_t>(state.range(0));
+
+    for (auto _ : state) {
+        for (uint16_t offset = 0; offset < 0x400; offset++)
+            benchmark::DoNotOptimize(membus.fetch_u8(base + offset));
+    }
+
+    state.SetItemsProcessed(state.iterations() * 0x400);
+}
+
+BENCHMARK(BM_bus_fetch_u8)->Arg(0x0000)->Arg(0x1800)->Arg(0x6000)->Arg(0x8000)->Arg(0xc000);
+
+static void BM_bus_fetch_u16(benchmark::State &state) {
+    auto console = core::console(bench::make_rom("bus", bench::dex_loop));
+    auto &membus = console.membus();
+    auto base = static_cast<uint16_t>(state.range(0));
+
+    for (auto _ : state) {
+        for (uint16_t offset = 0; offset < 0x400; offset += 2)
+            benchmark::DoNotOptimize(membus.fetch_u16(base + offset));
+    }
+
+    state.SetItemsProcessed(state.iterations() * 0x200);
+}
+
+BENCHMARK(BM_bus_fetch_u16)->Arg(0x0000)->Arg(0x1800)->Arg(0x6000)->Arg(0x8000)->Arg(0xc000);
+
+static void BM_bus_store_u8(benchmark::State &state) {
+    auto console = core::console(bench::make_rom("bus", bench::dex_loop));
+    auto &membus = console.membus();
+    auto base = static_cast<uint16_t>(state.range(0));
+
+    for (auto _ : state) {
+        for (uint16_t offset = 0; offset < 0x400; offset++)
+            membus.store(static_cast<uint16_t>(base + offset), static_cast<uint8_t>(offset));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * 0x400);
+}
+
+BENCHMARK(BM_bus_store_u8)->Arg(0x0000)->Arg(0x6000);
+
+static void BM_block_fetch_u8(benchmark::State &state) {
+    auto block = memory::block(0x800);
+
+    for (auto _ : state) {
+        for (uint16_t addr = 0; addr < 0x800; addr++)
+            benchmark::DoNotOptimize(block.fetch_u8(addr));
+    }
+
+    state.SetItemsProcessed(state.iterations() * 0x800);
+}
+
+BENCHMARK(BM_block_fetch_u8);
+
+static void BM_block_fetch_u16(benchmark::State &state) {
+    auto block = memory::block(0x800);
+
+    for (auto _ : state) {
+        for (uint16_t addr = 0; addr < 0x7ff; addr += 2)
+            benchmark::DoNotOptimize(block.fetch_u16(addr));
+    }
+
+    state.SetItemsProcessed(state.iterations() * 0x400);
+}
+
+BENCHMARK(BM_block_fetch_u16);
+
+static void BM_block_store_u8(benchmark::State &state) {
+    auto block = memory::block(0x800);
+
+    for (auto _ : state) {
+        for (uint16_t addr = 0; addr < 0x800; addr++)
+            block.store(addr, static_cast<uint8_t>(addr));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * 0x800);
+}
+
+BENCHMARK(BM_block_store_u8);
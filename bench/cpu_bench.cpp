@@ -0,0 +1,76 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <cstdlib>
+
+#include <benchmark/benchmark.h>
+
+#include "core/console.h"
+#include "bench_rom.h"
+
+using namespace nes;
+
+// Run whole frames and report emulated instructions per second (MIPS = instructions / 1e6) and
+// emulated frames per second. The argument selects the interpreter (0) or the jit (1).
+static void run_frames(benchmark::State &state, std::filesystem::path const &rom) {
+    auto console = core::console(rom);
+    auto &cpu = console.cpu();
+    if (state.range(0) && !cpu.enable_jit(true)) {
+        state.SkipWithError("jit not supported");
+        return;
+    }
+
+    auto instructions = cpu.instructions();
+    auto cycles = cpu.cycles();
+    for (auto _ : state)
+        cpu.run(cpu::ntsc_cycles_per_frame);
+
+    state.counters["instructions"] = benchmark::Counter(static_cast<double>(cpu.instructions() - instructions),
+                                                        benchmark::Counter::kIsRate);
+    state.counters["frames"] = benchmark::Counter(
+            static_cast<double>(cpu.cycles() - cycles) / static_cast<double>(cpu::ntsc_cycles_per_frame),
+            benchmark::Counter::kIsRate);
+}
+
+static void BM_cpu_dex_loop(benchmark::State &state) {
+    run_frames(state, bench::make_rom("dex_loop", bench::dex_loop));
+}
+
+BENCHMARK(BM_cpu_dex_loop)->Arg(0)->Arg(1);
+
+static void BM_cpu_alu_loop(benchmark::State &state) {
+    run_frames(state, bench::make_rom("alu_loop", bench::alu_loop));
+}
+
+BENCHMARK(BM_cpu_alu_loop)->Arg(0)->Arg(1);
+
+static void BM_cpu_copy_loop(benchmark::State &state) {
+    run_frames(state, bench::make_rom("copy_loop", bench::copy_loop));
+}
+
+BENCHMARK(BM_cpu_copy_loop)->Arg(0)->Arg(1);
+
+static void BM_cpu_call_loop(benchmark::State &state) {
+    run_frames(state, bench::make_rom("call_loop", bench::call_loop));
+}
+
+BENCHMARK(BM_cpu_call_loop)->Arg(0)->Arg(1);
+
+static void BM_cpu_homebrew(benchmark::State &state) {
+    run_frames(state, bench::make_rom("homebrew", bench::homebrew(), 0x8040));
+}
+
+BENCHMARK(BM_cpu_homebrew)->Arg(0)->Arg(1);
+
+// any rom given through NES_BENCH_ROM
+static void BM_cpu_rom(benchmark::State &state) {
+    auto rom = std::getenv("NES_BENCH_ROM");
+    if (!rom) {
+        state.SkipWithError("NES_BENCH_ROM not set");
+        return;
+    }
+    run_frames(state, rom);
+}
+
+BENCHMARK(BM_cpu_rom)->Arg(0)->Arg(1);
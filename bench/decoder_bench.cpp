@@ -0,0 +1,45 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <numeric>
+
+#include <benchmark/benchmark.h>
+
+#include "core/console.h"
+#include "cpu/decoder.h"
+#include "bench_rom.h"
+
+using namespace nes;
+
+// every opcode, one after the other, in the first page of prg-rom
+static void BM_decode_all_opcodes(benchmark::State &state) {
+    std::vector<uint8_t> code(0x100);
+    std::iota(code.begin(), code.end(), 0);
+    auto console = core::console(bench::make_rom("decode_all", code));
+    auto &membus = console.membus();
+
+    for (auto _ : state) {
+        for (uint16_t addr = 0x8000; addr < 0x8100; addr++)
+            benchmark::DoNotOptimize(cpu::decoder::decode(addr, membus));
+    }
+
+    state.SetItemsProcessed(state.iterations() * 0x100);
+}
+
+BENCHMARK(BM_decode_all_opcodes);
+
+// a single opcode decoded over and over, to spot slow entries
+static void BM_decode_opcode(benchmark::State &state) {
+    std::vector<uint8_t> code{static_cast<uint8_t>(state.range(0)), 0x10, 0x02};
+    auto console = core::console(bench::make_rom("decode_one", code));
+    auto &membus = console.membus();
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(cpu::decoder::decode(0x8000, membus));
+
+    state.SetLabel(fmt::format("{}", cpu::decoder::decode(0x8000, membus)));
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_decode_opcode)->DenseRange(0x00, 0xff);
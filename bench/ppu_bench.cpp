@@ -0,0 +1,95 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <array>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "ppu/pixel_kernels.h"
+#include "ppu/ppu.h"
+#include "bench_rom.h"
+
+using namespace nes;
+
+namespace {
+    template<std::size_t N>
+    std::array<uint8_t, N> random_bytes(uint8_t mask = 0xff) {
+        std::array<uint8_t, N> bytes{};
+        std::mt19937 rng(42);
+        for (auto &byte : bytes)
+            byte = static_cast<uint8_t>(rng()) & mask;
+        return bytes;
+    }
+
+    bool select_level(benchmark::State &state, ppu::simd_level level) {
+        state.SetLabel(std::string(ppu::simd_level2string(level)));
+        if (ppu::simd_supported(level))
+            return true;
+        state.SkipWithError("not supported by this cpu");
+        return false;
+    }
+}
+
+// range(0) is the simd_level, one scanline worth of background tiles
+static void BM_decode_tiles(benchmark::State &state) {
+    auto level = static_cast<ppu::simd_level>(state.range(0));
+    if (!select_level(state, level))
+        return;
+
+    auto &kernels = ppu::kernels_for(level);
+    auto lo = random_bytes<33>();
+    auto hi = random_bytes<33>();
+    auto palette = random_bytes<33>(0x0c);
+    std::array<uint8_t, 33 * 8> line{};
+
+    for (auto _ : state) {
+        kernels.decode_tiles(lo.data(), hi.data(), palette.data(), lo.size(), line.data());
+        benchmark::DoNotOptimize(line.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * line.size());
+}
+
+BENCHMARK(BM_decode_tiles)->DenseRange(0, 2);
+
+// range(0) is the simd_level, one scanline of background and sprite pixels
+static void BM_compose(benchmark::State &state) {
+    auto level = static_cast<ppu::simd_level>(state.range(0));
+    if (!select_level(state, level))
+        return;
+
+    auto &kernels = ppu::kernels_for(level);
+    auto background = random_bytes<ppu::width>(0x0f);
+    auto sprites = random_bytes<ppu::width>(0x5f);
+    auto palette = random_bytes<0x20>(0x3f);
+    std::array<uint8_t, ppu::width> out{};
+
+    for (auto _ : state) {
+        kernels.compose(background.data(), sprites.data(), palette.data(), 0x3f, out.size(), out.data());
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * out.size());
+}
+
+BENCHMARK(BM_compose)->DenseRange(0, 2);
+
+// whole frames with background and sprites enabled, using the kernels picked at runtime
+static void BM_ppu_frame(benchmark::State &state) {
+    auto cartridge = cartridge::cartridge(bench::make_rom("ppu", bench::dex_loop));
+    auto ppu = ppu::ppu(cartridge);
+    ppu.store_register(0x2001, 0x1e);
+    state.SetLabel(std::string(ppu::simd_level2string(ppu::detect_simd())));
+
+    for (auto _ : state)
+        ppu.run(ppu::dots_per_scanline * ppu::scanlines_per_frame);
+
+    state.counters["frames"] = benchmark::Counter(static_cast<double>(state.iterations()),
+                                                  benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_ppu_frame);
@@ -0,0 +1,165 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_APU_H
+#define NES_CPP_APU_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "cartridge/cartridge.h"
+
+namespace nes::apu {
+    struct apu_impl;
+
+    constexpr int sample_rate{44100};
+
+    // Every register, counter and timer of the apu, in the fixed layout of save states. Times are in
+    // cpu cycles since power up.
+    struct apu_state {
+        struct envelope {
+            bool start{false};
+            bool loop{false};
+            bool constant{false};
+            // constant volume, or period of the decay
+            uint8_t volume{0};
+            uint8_t divider{0};
+            uint8_t decay{0};
+        };
+
+        struct pulse_channel {
+            envelope env{};
+            bool enabled{false};
+            uint8_t duty{0};
+            uint8_t step{0};
+            uint8_t length{0};
+            bool sweep_enabled{false};
+            bool sweep_negate{false};
+            bool sweep_reload{false};
+            uint8_t sweep_period{0};
+            uint8_t sweep_shift{0};
+            uint8_t sweep_divider{0};
+            uint16_t period{0};
+            uint64_t next_clock{0};
+        };
+
+        struct triangle_channel {
+            bool enabled{false};
+            bool control{false};
+            bool linear_reload{false};
+            uint8_t linear_period{0};
+            uint8_t linear{0};
+            uint8_t length{0};
+            uint8_t step{0};
+            uint16_t period{0};
+            uint64_t next_clock{0};
+        };
+
+        struct noise_channel {
+            envelope env{};
+            bool enabled{false};
+            bool mode{false};
+            uint8_t length{0};
+            uint8_t period{0};
+            uint16_t shift{1};
+            uint64_t next_clock{0};
+        };
+
+        struct dmc_channel {
+            bool irq_enabled{false};
+            bool loop{false};
+            bool irq{false};
+            bool silence{true};
+            bool buffer_full{false};
+            uint8_t rate{0};
+            uint8_t level{0};
+            uint8_t shift{0};
+            uint8_t bits{8};
+            uint8_t buffer{0};
+            uint16_t sample_addr{0xc000};
+            uint16_t sample_length{1};
+            uint16_t addr{0xc000};
+            uint16_t remaining{0};
+            uint64_t next_clock{0};
+        };
+
+        pulse_channel pulse1{};
+        pulse_channel pulse2{};
+        triangle_channel triangle{};
+        noise_channel noise{};
+        dmc_channel dmc{};
+
+        bool five_step{false};
+        bool irq_inhibit{false};
+        bool frame_irq{false};
+        uint8_t frame_step{0};
+        // when the frame sequencer was last reset or wrapped
+        uint64_t frame_start{0};
+        uint64_t time{0};
+    };
+
+    // 2A03 audio processing unit: two pulse channels, triangle, noise, delta modulation and the frame
+    // sequencer clocking their envelopes, sweeps and counters. The apu is emulated lazily: run() only
+    // counts cycles, and the channels are caught up from one timer edge to the next when a register is
+    // accessed or samples are read. Amplitude changes are mixed and fed to a band-limited synthesizer;
+    // with the output disabled (the default) the tone channels are not clocked at all.
+    class apu {
+    public:
+        explicit apu(cartridge::cartridge &cartridge);
+
+        ~apu();
+
+        apu(apu const &) = delete;
+
+        apu &operator=(apu const &) = delete;
+
+        void reset();
+
+        // $4015, the only readable register
+        uint8_t fetch_register(uint16_t addr);
+
+        // $4000-$4013, $4015 and $4017
+        void store_register(uint16_t addr, uint8_t data);
+
+        // advance by cycles cpu cycles
+        void run(uint64_t cycles) noexcept {
+            _pending += cycles;
+        }
+
+        // frame sequencer or dmc irq line level
+        [[nodiscard]] bool irq();
+
+        // number of cycles run() can advance by before the irq line rises, 0 when it is already high
+        // and the maximum when neither irq is enabled. It may be early, never late.
+        [[nodiscard]] uint64_t cycles_to_irq();
+
+        // number of cycles run() can advance by before the dmc reads its next sample byte, the maximum
+        // when no sample is playing
+        [[nodiscard]] uint64_t cycles_to_dma();
+
+        // cpu cycles stolen by the dmc sample reads since the last call, the caller charges them to the cpu
+        uint64_t take_dma_stall();
+
+        void enable_output(bool enabled);
+
+        [[nodiscard]] bool output_enabled() const noexcept;
+
+        // synthesize up to the current cycle and move at most out.size() mono samples at sample_rate to
+        // out, return how many. Samples not read within half a second are dropped.
+        std::size_t read_samples(std::span<int16_t> out);
+
+        void save(apu_state &state);
+
+        void load(apu_state const &state);
+
+    private:
+        void catch_up();
+
+        uint64_t _pending{0};
+        std::unique_ptr<apu_impl> _impl;
+    };
+}
+
+#endif //NES_CPP_APU_H
@@ -0,0 +1,58 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_BLIP_BUFFER_H
+#define NES_CPP_BLIP_BUFFER_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace nes::apu {
+
+    // Band-limited step synthesis. The sound is described by its amplitude changes, timestamped in
+    // clocks of the emulated chip; every change adds a windowed sinc impulse, at the sub-sample
+    // position it falls on, to a buffer of deltas at the output rate. Summing the deltas gives the
+    // band-limited signal, so the chip is never sampled and the cost is per change, not per clock.
+    class blip_buffer {
+    public:
+        static constexpr int taps{16};
+        static constexpr int phases{32};
+
+        // capacity is the number of samples a frame can hold
+        blip_buffer(double clock_rate, double sample_rate, std::size_t capacity);
+
+        // clock is relative to the start of the frame and must stay below max_clocks()
+        void add_delta(uint64_t clock, float delta) noexcept {
+            auto position = _offset + static_cast<double>(clock) * _factor;
+            auto index = static_cast<std::size_t>(position);
+            auto phase = static_cast<int>((position - static_cast<double>(index)) * phases);
+            auto const &kernel = _kernels[phase];
+            auto out = &_deltas[index];
+            for (int i = 0; i < taps; i++)
+                out[i] += kernel[i] * delta;
+        }
+
+        [[nodiscard]] uint64_t max_clocks() const noexcept;
+
+        // close a frame of clocks, append its completed samples to out
+        void end_frame(uint64_t clocks, std::vector<int16_t> &out);
+
+        void clear() noexcept;
+
+    private:
+        double _factor;
+        // position of the frame start, in samples
+        double _offset{0};
+        std::size_t _capacity;
+        std::vector<float> _deltas;
+        std::array<std::array<float, taps>, phases> _kernels{};
+        float _sum{0};
+        // dc blocking high-pass filter
+        float _last_in{0};
+        float _last_out{0};
+    };
+}
+
+#endif //NES_CPP_BLIP_BUFFER_H
@@ -5,24 +5,33 @@
 #ifndef NES_CPP_CARTRIDGE_H
 #define NES_CPP_CARTRIDGE_H
 
+#include <array>
 #include <memory>
 #include <filesystem>
 
 #include <fmt/format.h>
 
+#include "cartridge/mapper.h"
+#include "cartridge/rom.h"
 #include "memory/memory_interface.h"
 
 namespace nes::cartridge {
     struct cartridge_impl;
 
-    enum class mapper_type : std::uint8_t {
-        mapper_0
+    // cartridge ram and board registers, chr_ram is only used by boards without chr-rom
+    struct cartridge_state {
+        std::array<uint8_t, 0x2000> prg_ram{};
+        std::array<uint8_t, 0x8000> chr_ram{};
+        mapper_state mapper{};
     };
 
     class cartridge : public memory::memory_iface {
     public:
         explicit cartridge(std::filesystem::path path);
 
+        // share an already loaded rom, every cartridge gets its own ram
+        explicit cartridge(std::shared_ptr<rom const> rom);
+
         ~cartridge();
 
         cartridge(cartridge const &) = delete;
@@ -31,6 +40,10 @@ namespace nes::cartridge {
 
         [[nodiscard]] std::filesystem::path file() const noexcept;
 
+        [[nodiscard]] std::shared_ptr<rom const> const &image() const noexcept;
+
+        [[nodiscard]] rom_header const &header() const noexcept;
+
         [[nodiscard]] bool mirroring() const noexcept;
 
         [[nodiscard]] bool battery_packed_ram() const noexcept;
@@ -41,16 +54,35 @@ namespace nes::cartridge {
 
         [[nodiscard]] mapper_type mapper() const noexcept;
 
+        // bank registers and bank pointers of the board
+        [[nodiscard]] class mapper &board() const noexcept;
+
+        // current nametable layout, may be changed by the mapper
+        [[nodiscard]] mirroring_mode nametable_mirroring() const noexcept;
+
+        // host memory backing a 256-byte cpu page, nullptr when the page is not directly addressable
+        [[nodiscard]] uint8_t const *prg_page(std::uint8_t page) const noexcept;
+
+        [[nodiscard]] uint8_t *prg_ram_page(std::uint8_t page) const noexcept;
+
+        // pattern tables, either chr-rom or chr-ram
+        [[nodiscard]] std::span<uint8_t const> chr() const noexcept;
+
         [[nodiscard]] uint8_t fetch_u8(std::uint16_t addr) const final;
 
         [[nodiscard]] uint16_t fetch_u16(std::uint16_t addr) const final;
 
-        [[nodiscard]] std::vector<uint8_t> const& data() const final;
+        [[nodiscard]] std::span<uint8_t const> data() const final;
 
         void store(std::uint16_t addr, std::uint8_t data) final;
 
         void store(std::uint16_t addr, std::uint16_t data) final;
 
+        void save(cartridge_state &state) const noexcept;
+
+        // state must have been saved from the same board
+        void load(cartridge_state const &state) noexcept;
+
     private:
         std::unique_ptr<cartridge_impl> _impl;
     };
@@ -66,7 +98,8 @@ struct fmt::formatter<nes::cartridge::cartridge> {
     template<typename FormatContext>
     auto format(const nes::cartridge::cartridge &p, FormatContext &ctx) {
         return format_to(ctx.out(), "rom_file={} m={} b={} t={} i={} mapper={}", p.file().string(), p.mirroring(),
-                         p.battery_packed_ram(), p.trainer(), p.ignore_mirroring(), p.mapper());
+                         p.battery_packed_ram(), p.trainer(), p.ignore_mirroring(),
+                         static_cast<int>(p.mapper()));
     }
 };
 
@@ -0,0 +1,135 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_MAPPER_H
+#define NES_CPP_MAPPER_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+
+#include "cartridge/rom.h"
+
+namespace nes::cartridge {
+
+    enum class mapper_type : std::uint8_t {
+        mapper_0,   // NROM
+        mapper_1,   // MMC1 (SxROM)
+        mapper_2,   // UxROM
+        mapper_3,   // CNROM
+        mapper_4,   // MMC3 (TxROM)
+    };
+
+    enum class mirroring_mode : std::uint8_t {
+        horizontal,
+        vertical,
+        single_screen_lo,
+        single_screen_hi,
+        four_screen
+    };
+
+    // bank registers of a board, in the fixed layout of save states
+    struct mapper_state {
+        mapper_type type{mapper_type::mapper_0};
+        mirroring_mode mirroring{mirroring_mode::horizontal};
+        std::array<uint8_t, 16> regs{};
+    };
+
+    // A mapper owns the bank registers of a board. Reads never compute bank offsets: every register
+    // write recomputes pointers to the 8k prg banks seen at $8000, $a000, $c000, $e000 and to the
+    // 1k chr banks seen by the ppu.
+    class mapper {
+    public:
+        mapper(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram);
+
+        virtual ~mapper() = default;
+
+        mapper(mapper const &) = delete;
+
+        mapper &operator=(mapper const &) = delete;
+
+        [[nodiscard]] virtual mapper_type type() const noexcept = 0;
+
+        // cpu write to a mapper register ($8000-$ffff)
+        virtual void store(uint16_t addr, uint8_t data) = 0;
+
+        // called by the ppu at the end of every rendered scanline
+        virtual void scanline() noexcept {}
+
+        // irq line level
+        [[nodiscard]] virtual bool irq() const noexcept { return false; }
+
+        // number of scanline() calls before the irq line rises, 0 when it is already high
+        [[nodiscard]] virtual uint32_t scanlines_to_irq() const noexcept {
+            return std::numeric_limits<uint32_t>::max();
+        }
+
+        // copy the registers to or from state, load() maps the banks again
+        virtual void save(mapper_state &state) const noexcept;
+
+        virtual void load(mapper_state const &state) noexcept;
+
+        // host memory backing a 256-byte cpu page in $8000-$ffff
+        [[nodiscard]] uint8_t const *prg_page(uint8_t page) const noexcept {
+            return _prg[(page >> 5u) & 0x03u] + ((page & 0x1fu) << 8u);
+        }
+
+        [[nodiscard]] uint8_t fetch_chr(uint16_t addr) const noexcept {
+            return _chr[(addr >> 10u) & 0x07u][addr & 0x3ffu];
+        }
+
+        // dropped unless the board has chr-ram
+        void store_chr(uint16_t addr, uint8_t data) noexcept {
+            if (!_chr_ram.empty())
+                _chr_ram[_chr_offsets[(addr >> 10u) & 0x07u] + (addr & 0x3ffu)] = data;
+        }
+
+        // 1k chr bank mapped at ppu address slot * $400
+        [[nodiscard]] uint8_t const *chr_bank(uint8_t slot) const noexcept {
+            return _chr[slot & 0x07u];
+        }
+
+        [[nodiscard]] mirroring_mode mirroring() const noexcept {
+            return _mirroring;
+        }
+
+    protected:
+        // bank numbers are in units of the mapped size and wrap around the rom size
+        void map_prg_8k(uint8_t slot, int bank) noexcept;
+
+        void map_prg_16k(uint8_t slot, int bank) noexcept;
+
+        void map_prg_32k(int bank) noexcept;
+
+        void map_chr_1k(uint8_t slot, int bank) noexcept;
+
+        void map_chr_4k(uint8_t slot, int bank) noexcept;
+
+        void map_chr_8k(int bank) noexcept;
+
+        [[nodiscard]] int prg_banks_8k() const noexcept {
+            return static_cast<int>(_prg_rom.size() / 0x2000);
+        }
+
+        std::shared_ptr<rom const> _rom;
+        std::span<uint8_t const> _prg_rom;
+        // chr-rom or chr-ram, and chr-ram alone, empty when the board has chr-rom
+        std::span<uint8_t const> _chr_mem;
+        std::span<uint8_t> _chr_ram;
+        mirroring_mode _mirroring{mirroring_mode::horizontal};
+
+    private:
+        std::array<uint8_t const *, 4> _prg{};
+        std::array<uint8_t const *, 8> _chr{};
+        // offset of each 1k bank in _chr_mem, for the writes to chr-ram
+        std::array<std::size_t, 8> _chr_offsets{};
+    };
+
+    // throws rom_error for unsupported mappers
+    std::unique_ptr<mapper> make_mapper(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram);
+}
+
+#endif //NES_CPP_MAPPER_H
@@ -0,0 +1,111 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_MAPPERS_H
+#define NES_CPP_MAPPERS_H
+
+#include "cartridge/mapper.h"
+
+namespace nes::cartridge {
+
+    // 16k or 32k prg, 8k chr, no registers
+    class nrom final : public mapper {
+    public:
+        nrom(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram);
+
+        [[nodiscard]] mapper_type type() const noexcept final { return mapper_type::mapper_0; }
+
+        void store(uint16_t addr, uint8_t data) final;
+    };
+
+    // 5 bits serial shift register feeding control, chr0, chr1 and prg registers
+    class mmc1 final : public mapper {
+    public:
+        mmc1(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram);
+
+        [[nodiscard]] mapper_type type() const noexcept final { return mapper_type::mapper_1; }
+
+        void store(uint16_t addr, uint8_t data) final;
+
+        void save(mapper_state &state) const noexcept final;
+
+        void load(mapper_state const &state) noexcept final;
+
+    private:
+        void update_banks() noexcept;
+
+        uint8_t _shift{0x10};
+        uint8_t _control{0x0c};
+        uint8_t _chr0{0};
+        uint8_t _chr1{0};
+        uint8_t _prg{0};
+    };
+
+    // switchable 16k at $8000, last 16k fixed at $c000
+    class uxrom final : public mapper {
+    public:
+        uxrom(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram);
+
+        [[nodiscard]] mapper_type type() const noexcept final { return mapper_type::mapper_2; }
+
+        void store(uint16_t addr, uint8_t data) final;
+
+        void save(mapper_state &state) const noexcept final;
+
+        void load(mapper_state const &state) noexcept final;
+
+    private:
+        uint8_t _bank{0};
+    };
+
+    // switchable 8k chr
+    class cnrom final : public mapper {
+    public:
+        cnrom(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram);
+
+        [[nodiscard]] mapper_type type() const noexcept final { return mapper_type::mapper_3; }
+
+        void store(uint16_t addr, uint8_t data) final;
+
+        void save(mapper_state &state) const noexcept final;
+
+        void load(mapper_state const &state) noexcept final;
+
+    private:
+        uint8_t _bank{0};
+    };
+
+    // 8 bank registers, two prg and chr layouts, scanline counter irq
+    class mmc3 final : public mapper {
+    public:
+        mmc3(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram);
+
+        [[nodiscard]] mapper_type type() const noexcept final { return mapper_type::mapper_4; }
+
+        void store(uint16_t addr, uint8_t data) final;
+
+        void scanline() noexcept final;
+
+        [[nodiscard]] bool irq() const noexcept final { return _irq_pending; }
+
+        [[nodiscard]] uint32_t scanlines_to_irq() const noexcept final;
+
+        void save(mapper_state &state) const noexcept final;
+
+        void load(mapper_state const &state) noexcept final;
+
+    private:
+        void update_banks() noexcept;
+
+        uint8_t _bank_select{0};
+        std::array<uint8_t, 8> _banks{0, 2, 4, 5, 6, 7, 0, 1};
+        uint8_t _irq_latch{0};
+        uint8_t _irq_counter{0};
+        bool _irq_reload{false};
+        bool _irq_enabled{false};
+        bool _irq_pending{false};
+    };
+}
+
+#endif //NES_CPP_MAPPERS_H
@@ -0,0 +1,71 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_ROM_H
+#define NES_CPP_ROM_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stdexcept>
+
+namespace nes::cartridge {
+    struct rom_impl;
+
+    class rom_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // iNES / NES 2.0 header, sizes are in bytes
+    struct rom_header {
+        bool nes2{false};
+        uint16_t mapper{0};
+        uint8_t submapper{0};
+        bool vertical_mirroring{false};
+        bool battery{false};
+        bool trainer{false};
+        bool four_screen{false};
+        uint8_t console_type{0};
+        uint8_t timing{0};
+        std::size_t prg_rom_size{0};
+        std::size_t chr_rom_size{0};
+        std::size_t prg_ram_size{0};
+        std::size_t prg_nvram_size{0};
+        std::size_t chr_ram_size{0};
+        std::size_t chr_nvram_size{0};
+    };
+
+    // A rom file mapped read-only in memory. prg and chr are views into the mapping, nothing is
+    // copied, so a rom can be shared by every cartridge instance running it.
+    class rom {
+    public:
+        explicit rom(std::filesystem::path path);
+
+        ~rom();
+
+        rom(rom const &) = delete;
+
+        rom &operator=(rom const &) = delete;
+
+        [[nodiscard]] std::filesystem::path const &file() const noexcept;
+
+        [[nodiscard]] rom_header const &header() const noexcept;
+
+        [[nodiscard]] std::span<uint8_t const> trainer() const noexcept;
+
+        [[nodiscard]] std::span<uint8_t const> prg() const noexcept;
+
+        [[nodiscard]] std::span<uint8_t const> chr() const noexcept;
+
+    private:
+        std::unique_ptr<rom_impl> _impl;
+    };
+
+    // parse the header at the start of a rom file, throws rom_error when it is not a valid one
+    rom_header parse_header(std::span<uint8_t const> data);
+}
+
+#endif //NES_CPP_ROM_H
@@ -0,0 +1,51 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_BATCH_H
+#define NES_CPP_BATCH_H
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nes::core {
+
+    // 64 bits digest of a framebuffer, to compare runs
+    [[nodiscard]] uint64_t hash_frame(std::span<uint8_t const> pixels) noexcept;
+
+    struct batch_job {
+        std::filesystem::path rom;
+        uint64_t frames{600};
+        bool jit{false};
+        // also keep the hash of every n-th frame, 0 for none
+        uint64_t hash_every{0};
+        // fm2 input movie played from power-on, empty for none
+        std::filesystem::path movie;
+    };
+
+    struct batch_result {
+        batch_job job;
+        uint64_t frames{0};
+        uint64_t cycles{0};
+        uint64_t instructions{0};
+        double seconds{0.0};
+        // frames are hashed as the ppu enters vblank. (frame, hash) every job.hash_every frames
+        std::vector<std::pair<uint64_t, uint64_t>> hashes;
+        uint64_t last_hash{0};
+        // digest of the hashes of every frame
+        uint64_t chain_hash{0};
+        // empty when the job ran
+        std::string error;
+    };
+
+    // Run every job on a work-stealing pool, each in its own console, and return the results in job
+    // order. A rom is loaded once and its prg/chr shared read-only by all the jobs running it.
+    // 0 threads means one per hardware thread.
+    std::vector<batch_result> run_batch(std::vector<batch_job> const &jobs, std::size_t threads = 0);
+}
+
+#endif //NES_CPP_BATCH_H
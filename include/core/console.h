@@ -0,0 +1,120 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_CONSOLE_H
+#define NES_CPP_CONSOLE_H
+
+#include <filesystem>
+#include <memory>
+
+#include "apu/apu.h"
+#include "cartridge/cartridge.h"
+#include "cartridge/rom.h"
+#include "cpu/cpu.h"
+#include "core/save_state.h"
+#include "cpu/cpu_mem_bus.h"
+#include "cpu/scheduler.h"
+#include "input/controller.h"
+#include "input/movie.h"
+#include "ppu/ppu.h"
+
+namespace nes::core {
+
+    // The whole machine in one object. Every part is owned by value and the parts refer to each other
+    // by reference, so the members are declared in dependency order: each one is built after, and
+    // destroyed before, the parts it points into. A console cannot be copied nor moved.
+    class console {
+    public:
+        explicit console(std::filesystem::path path);
+
+        // share an already loaded rom, the console still gets its own cartridge ram
+        explicit console(std::shared_ptr<cartridge::rom const> rom);
+
+        ~console() = default;
+
+        console(console const &) = delete;
+
+        console &operator=(console const &) = delete;
+
+        // plain copies of every part, once the ppu and the apu have been caught up with the clock
+        void save(save_state &state);
+
+        // throws state_error when state comes from another version or another board
+        void load(save_state const &state);
+
+        // run the cpu until the ppu starts the next vblank, return the number of cycles run. The framebuffer
+        // then holds the whole picture of the frame that just ended.
+        uint64_t run_frame();
+
+        // the input of the next frame, resetting the console first when the frame asks for it
+        void set_input(input::movie_frame const &frame);
+
+        [[nodiscard]] cartridge::cartridge &cartridge() noexcept {
+            return _cartridge;
+        }
+
+        [[nodiscard]] ppu::ppu &ppu() noexcept {
+            return _ppu;
+        }
+
+        [[nodiscard]] apu::apu &apu() noexcept {
+            return _apu;
+        }
+
+        [[nodiscard]] input::controllers &controllers() noexcept {
+            return _controllers;
+        }
+
+        [[nodiscard]] cpu::scheduler &scheduler() noexcept {
+            return _scheduler;
+        }
+
+        [[nodiscard]] cpu::cpu_mem_bus &membus() noexcept {
+            return _membus;
+        }
+
+        [[nodiscard]] cpu::cpu &cpu() noexcept {
+            return _cpu;
+        }
+
+        [[nodiscard]] cartridge::cartridge const &cartridge() const noexcept {
+            return _cartridge;
+        }
+
+        [[nodiscard]] ppu::ppu const &ppu() const noexcept {
+            return _ppu;
+        }
+
+        [[nodiscard]] apu::apu const &apu() const noexcept {
+            return _apu;
+        }
+
+        [[nodiscard]] input::controllers const &controllers() const noexcept {
+            return _controllers;
+        }
+
+        [[nodiscard]] cpu::scheduler const &scheduler() const noexcept {
+            return _scheduler;
+        }
+
+        [[nodiscard]] cpu::cpu_mem_bus const &membus() const noexcept {
+            return _membus;
+        }
+
+        [[nodiscard]] cpu::cpu const &cpu() const noexcept {
+            return _cpu;
+        }
+
+    private:
+        cartridge::cartridge _cartridge;
+        ppu::ppu _ppu;
+        apu::apu _apu;
+        input::controllers _controllers;
+        cpu::scheduler _scheduler;
+        cpu::cpu_mem_bus _membus;
+        cpu::cpu _cpu;
+    };
+}
+
+#endif //NES_CPP_CONSOLE_H
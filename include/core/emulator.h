@@ -0,0 +1,106 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_EMULATOR_H
+#define NES_CPP_EMULATOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "cartridge/rom.h"
+#include "cpu/decoder.h"
+#include "cpu/regs.h"
+#include "ppu/ppu.h"
+
+namespace nes::core {
+
+    // a completed picture, as 6 bits palette values (see ntsc_palette)
+    struct frame {
+        std::array<uint8_t, ppu::width * ppu::height> pixels{};
+        uint64_t number{0};
+    };
+
+    // what the debugger panels show, copied by the emulation thread after a frame or a step
+    struct debug_snapshot {
+        cpu::regs regs{};
+        uint64_t cycles{0};
+        uint64_t instructions{0};
+        std::array<uint8_t, 0x800> ram{};
+        // the instructions at regs.pc, the first listed ones are valid: the listing stops at code outside of
+        // ram and rom
+        std::array<cpu::decoded_op, 5> listing{};
+        std::size_t listed{0};
+        bool running{false};
+        bool tracing{false};
+        bool rewinding{false};
+        bool recording{false};
+        // frames that can be rewound
+        std::size_t history{0};
+    };
+
+    enum class command : uint8_t {
+        step,
+        toggle_running,
+        toggle_trace,
+        save_trace,
+        // go back one frame per frame period until rewind_stop, running or not
+        rewind_start,
+        rewind_stop,
+        // restart from power-on and record the buttons of every frame, until sent again: the movie is then
+        // saved next to the rom as an fm2 file
+        toggle_recording,
+    };
+
+    class emulator_impl;
+
+    // Runs the console on its own thread, paced at the ntsc frame rate. Completed frames and debugger
+    // snapshots are handed to the ui thread through lock-free triple buffers and the ui drives the
+    // emulation through a command queue, so neither side ever blocks the other. Audio samples go through
+    // a lock-free ring to whichever thread plays them. The state at the end of every frame is kept in a
+    // rewind buffer, and the buttons of every frame can be recorded as an input movie.
+    class emulator {
+    public:
+        explicit emulator(std::shared_ptr<cartridge::rom const> rom);
+
+        // stop and join the emulation thread
+        ~emulator();
+
+        emulator(emulator const &) = delete;
+
+        emulator &operator=(emulator const &) = delete;
+
+        void start();
+
+        void stop();
+
+        // queue a command for the emulation thread, false when the queue is full
+        bool send(command c);
+
+        // buttons held on the first controller (see input::button), applied at the start of each frame
+        void set_buttons(uint8_t buttons) noexcept;
+
+        // skip the snapshot copies while no debugger panel is shown
+        void enable_snapshots(bool enabled) noexcept;
+
+        // take the latest frame/snapshot if a new one was published, current_frame()/snapshot() then refer to it
+        bool poll_frame() noexcept;
+
+        [[nodiscard]] frame const &current_frame() const noexcept;
+
+        bool poll_snapshot() noexcept;
+
+        [[nodiscard]] debug_snapshot const &snapshot() const noexcept;
+
+        // audio consumer side: take at most out.size() samples, mono at apu::sample_rate, return how many
+        std::size_t read_audio(std::span<int16_t> out) noexcept;
+
+    private:
+        std::unique_ptr<emulator_impl> _impl;
+    };
+}
+
+#endif //NES_CPP_EMULATOR_H
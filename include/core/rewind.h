@@ -0,0 +1,47 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_REWIND_H
+#define NES_CPP_REWIND_H
+
+#include <cstddef>
+#include <memory>
+
+#include "core/save_state.h"
+
+namespace nes::core {
+    struct rewind_buffer_impl;
+
+    // History of save states in a fixed-size byte ring. Every keyframe_interval states a keyframe is
+    // stored whole, the states in between only as the difference with it: the xor of the two states,
+    // run-length encoded, which leaves a few hundred bytes for a typical frame. When the ring is full
+    // the oldest keyframe is dropped along with the states depending on it.
+    class rewind_buffer {
+    public:
+        explicit rewind_buffer(std::size_t capacity = 32u << 20u, std::size_t keyframe_interval = 60);
+
+        ~rewind_buffer();
+
+        rewind_buffer(rewind_buffer const &) = delete;
+
+        rewind_buffer &operator=(rewind_buffer const &) = delete;
+
+        void push(save_state const &state);
+
+        // take the newest state out of the history, false when it is empty
+        bool pop(save_state &state);
+
+        void clear() noexcept;
+
+        // number of states recorded, and the bytes they take in the ring
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        [[nodiscard]] std::size_t bytes() const noexcept;
+
+    private:
+        std::unique_ptr<rewind_buffer_impl> _impl;
+    };
+}
+
+#endif //NES_CPP_REWIND_H
@@ -0,0 +1,51 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_SAVE_STATE_H
+#define NES_CPP_SAVE_STATE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <type_traits>
+
+#include "apu/apu.h"
+#include "cartridge/cartridge.h"
+#include "cpu/cpu.h"
+#include "input/controller.h"
+#include "ppu/ppu.h"
+
+namespace nes::core {
+
+    class state_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // A snapshot of the whole console. The layout is fixed (no pointer, no variable size part), so a
+    // state is saved and restored with plain copies of each member and written to disk as is. The
+    // version is bumped whenever the layout changes, older states are then refused.
+    struct save_state {
+        static constexpr uint32_t magic{0x5353454e}; // "NESS"
+        static constexpr uint32_t current_version{3};
+
+        uint32_t tag{magic};
+        uint32_t version{current_version};
+        cpu::cpu_state cpu{};
+        std::array<uint8_t, 0x800> ram{};
+        cartridge::cartridge_state cartridge{};
+        ppu::ppu_state ppu{};
+        apu::apu_state apu{};
+        input::controller_state input{};
+    };
+
+    static_assert(std::is_trivially_copyable_v<save_state>, "save states are copied as raw bytes");
+
+    // throws state_error when the file cannot be written or read, or holds another version
+    void write_state(std::filesystem::path const &path, save_state const &state);
+
+    void read_state(std::filesystem::path const &path, save_state &state);
+}
+
+#endif //NES_CPP_SAVE_STATE_H
@@ -0,0 +1,57 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_SPSC_RING_H
+#define NES_CPP_SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace nes::core {
+
+    // Bounded lock-free queue between one producer thread and one consumer thread.
+    template<typename T, std::size_t Capacity>
+    class spsc_ring {
+        static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    public:
+        spsc_ring() = default;
+
+        spsc_ring(spsc_ring const &) = delete;
+
+        spsc_ring &operator=(spsc_ring const &) = delete;
+
+        // producer side, false when full
+        bool push(T const &value) noexcept {
+            auto head = _head.load(std::memory_order_relaxed);
+            if (head - _tail.load(std::memory_order_acquire) == Capacity)
+                return false;
+            _items[head & (Capacity - 1)] = value;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, false when empty
+        bool pop(T &value) noexcept {
+            auto tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire))
+                return false;
+            value = _items[tail & (Capacity - 1)];
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::array<T, Capacity> _items{};
+        alignas(64) std::atomic<std::size_t> _head{0};
+        alignas(64) std::atomic<std::size_t> _tail{0};
+    };
+}
+
+#endif //NES_CPP_SPSC_RING_H
@@ -0,0 +1,42 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_THREAD_POOL_H
+#define NES_CPP_THREAD_POOL_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace nes::core {
+    struct thread_pool_impl;
+
+    // Work-stealing pool: every worker has its own deque, takes the newest task from it and steals the
+    // oldest one of another worker when it runs dry. Tasks submitted from a worker go to that worker's
+    // deque, the others are spread round robin.
+    class thread_pool {
+    public:
+        // 0 threads means one per hardware thread
+        explicit thread_pool(std::size_t threads = 0);
+
+        // wait for every task, then join the workers
+        ~thread_pool();
+
+        thread_pool(thread_pool const &) = delete;
+
+        thread_pool &operator=(thread_pool const &) = delete;
+
+        void submit(std::function<void()> task);
+
+        // block until every submitted task has completed
+        void wait();
+
+        [[nodiscard]] std::size_t size() const noexcept;
+
+    private:
+        std::unique_ptr<thread_pool_impl> _impl;
+    };
+}
+
+#endif //NES_CPP_THREAD_POOL_H
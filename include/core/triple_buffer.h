@@ -0,0 +1,61 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_TRIPLE_BUFFER_H
+#define NES_CPP_TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace nes::core {
+
+    // Lock-free handoff of the latest value from one producer thread to one consumer thread. The producer
+    // fills its back slot and publishes it, the consumer swaps in the most recently published slot. Neither
+    // side ever waits: a value the consumer did not pick up in time is replaced by the next one.
+    template<typename T>
+    class triple_buffer {
+    public:
+        triple_buffer() = default;
+
+        triple_buffer(triple_buffer const &) = delete;
+
+        triple_buffer &operator=(triple_buffer const &) = delete;
+
+        // producer side: the slot to fill, then make it the latest value
+        T &back() noexcept {
+            return _slots[_back];
+        }
+
+        void publish() noexcept {
+            auto previous = _middle.exchange(static_cast<uint8_t>(_back | fresh), std::memory_order_acq_rel);
+            _back = previous & index_mask;
+        }
+
+        // consumer side: take the latest value if one was published since the last call, front() then refers to it
+        bool update() noexcept {
+            if (!(_middle.load(std::memory_order_relaxed) & fresh))
+                return false;
+            auto previous = _middle.exchange(_front, std::memory_order_acq_rel);
+            _front = previous & index_mask;
+            return true;
+        }
+
+        [[nodiscard]] T const &front() const noexcept {
+            return _slots[_front];
+        }
+
+    private:
+        static constexpr uint8_t index_mask{0x03};
+        static constexpr uint8_t fresh{0x04};
+
+        std::array<T, 3> _slots{};
+        // the slot in between, with the fresh bit set while the consumer has not taken it
+        alignas(64) std::atomic<uint8_t> _middle{1};
+        alignas(64) uint8_t _back{0};
+        alignas(64) uint8_t _front{2};
+    };
+}
+
+#endif //NES_CPP_TRIPLE_BUFFER_H
@@ -0,0 +1,75 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_BLOCK_CACHE_H
+#define NES_CPP_BLOCK_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "cpu/cpu_mem_bus.h"
+#include "cpu/decoder.h"
+
+namespace nes::cpu {
+
+    // Straight-line runs of decoded instructions. A block is tagged with its pc and
+    // the host page the code is mapped from, so a bank switch simply misses. Blocks end after a control
+    // flow instruction, before an instruction crossing a page boundary, or when full. Code decoded from
+    // ram has its page watched on the bus, and the block is dropped as soon as the page is written.
+    class block_cache {
+    public:
+        static constexpr std::size_t max_block_size{16};
+        static constexpr std::size_t entries{1024};
+
+        struct block {
+            uint16_t pc{0};
+            uint8_t size{0};
+            uint32_t generation{0};
+            uint8_t const *page{nullptr};
+            std::array<decoded_op, max_block_size> ops{};
+        };
+
+        explicit block_cache(cpu_mem_bus &membus);
+
+        ~block_cache() = default;
+
+        block_cache(block_cache const &) = delete;
+
+        block_cache &operator=(block_cache const &) = delete;
+
+        // the block starting at pc, decoded again if missing or stale
+        block const &lookup(uint16_t pc);
+
+        // the code the block was decoded from is still mapped and untouched
+        [[nodiscard]] bool valid(block const &b) const noexcept {
+            auto page = static_cast<uint8_t>(b.pc >> 8u);
+            return b.page && b.page == _membus.read_page(page) && b.generation == _membus.page_generation(page);
+        }
+
+        void clear() noexcept;
+
+        [[nodiscard]] uint64_t hits() const noexcept {
+            return _hits;
+        }
+
+        [[nodiscard]] uint64_t misses() const noexcept {
+            return _misses;
+        }
+
+    private:
+        static constexpr std::size_t index(uint16_t pc) noexcept {
+            return (pc ^ (pc >> 10u)) & (entries - 1);
+        }
+
+        cpu_mem_bus &_membus;
+        std::vector<block> _blocks;
+        // single instruction blocks for code that cannot be cached (io space, page crossing)
+        block _uncached;
+        uint64_t _hits{0};
+        uint64_t _misses{0};
+    };
+}
+
+#endif //NES_CPP_BLOCK_CACHE_H
@@ -0,0 +1,75 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_BUS_TRACE_H
+#define NES_CPP_BUS_TRACE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Bus tracing is compiled in only when configured with -DNES_TRACE=ON, release builds pay nothing.
+#if NES_TRACE
+#define NES_TRACE_BUS(trace, addr, data, access) \
+    do { if (trace) (trace)->record((addr), (data), (access)); } while (0)
+#else
+#define NES_TRACE_BUS(trace, addr, data, access) do {} while (0)
+#endif
+
+namespace nes::cpu {
+
+    enum class bus_access : uint8_t {
+        read,
+        write
+    };
+
+    struct bus_event {
+        uint16_t addr;
+        uint8_t data;
+        bus_access access;
+    };
+
+    static_assert(sizeof(bus_event) == 4);
+
+    // Fixed size ring of raw bus events, the oldest events are overwritten once it is full.
+    class bus_trace {
+    public:
+        // capacity is rounded up to a power of two
+        explicit bus_trace(std::size_t capacity = 1u << 20u);
+
+        ~bus_trace() = default;
+
+        bus_trace(bus_trace const &) = delete;
+
+        bus_trace &operator=(bus_trace const &) = delete;
+
+        void record(uint16_t addr, uint8_t data, bus_access access) noexcept {
+            _events[_head++ & _mask] = bus_event{addr, data, access};
+        }
+
+        void clear() noexcept { _head = 0; }
+
+        [[nodiscard]] std::size_t size() const noexcept { return _head < _events.size() ? _head : _events.size(); }
+
+        // number of events overwritten since the last clear
+        [[nodiscard]] std::size_t dropped() const noexcept { return _head - size(); }
+
+        // visit the recorded events from the oldest to the newest
+        template<typename Fn>
+        void for_each(Fn &&fn) const {
+            for (auto i = _head - size(); i < _head; i++)
+                fn(_events[i & _mask]);
+        }
+
+        // write the recorded events, oldest first, as packed bus_event records
+        void save(std::filesystem::path const &path) const;
+
+    private:
+        std::vector<bus_event> _events;
+        std::size_t _mask;
+        std::size_t _head{0};
+    };
+}
+
+#endif //NES_CPP_BUS_TRACE_H
@@ -0,0 +1,118 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_CPU_H
+#define NES_CPP_CPU_H
+
+#include <memory>
+
+#include "cpu/block_cache.h"
+#include "cpu/cpu_mem_bus.h"
+#include "cpu/decoder.h"
+#include "cpu/execute.h"
+#include "cpu/jit.h"
+#include "cpu/regs.h"
+#include "cpu/scheduler.h"
+
+namespace nes::cpu {
+
+    // registers and clocks, in the fixed layout of save states
+    struct cpu_state {
+        regs r{};
+        uint64_t cycles{0};
+        uint64_t instructions{0};
+    };
+
+    // NTSC timings, a frame is 341 * 262 ppu dots and the ppu runs 3 times faster than the cpu
+    constexpr double ntsc_clock_hz{1789773.0};
+    constexpr uint64_t ntsc_cycles_per_frame{29781};
+
+    // The cpu core runs against the bus of the console owning it, see core::console, and drives its
+    // master clock: the ppu and the apu only see the cpu through the scheduler.
+    class cpu {
+    public:
+        cpu(cpu_mem_bus &membus, scheduler &scheduler);
+
+        ~cpu();
+
+        cpu(cpu const &) = delete;
+
+        cpu &operator=(cpu const &) = delete;
+
+        // load pc from the reset vector and put the registers in their power-up state, reset the ppu and the
+        // apu. Used at power-on and for the reset button, the clock advances by 7 cycles and is not rewound.
+        void reset();
+
+        // execute a single instruction, and the interrupt it may trigger, return the number of cycles it took,
+        // dma stalls included. The ppu and the apu are caught up with the clock afterwards.
+        uint32_t step();
+
+        // execute instructions until at least cycle_budget cycles have elapsed,
+        // return the number of cycles actually executed. With the jit enabled, hot blocks run translated
+        // and interrupts are only taken between blocks, unless the bus is traced. The ppu and the apu are only caught up when the bus
+        // or a predicted event needs them, and once at the end.
+        uint64_t run(uint64_t cycle_budget);
+
+        void save(cpu_state &state) const noexcept;
+
+        // the ppu and the apu must have been loaded first, the clock restarts in sync with them
+        void load(cpu_state const &state) noexcept;
+
+        // turn the jit on or off for run(), return whether it is active (it may not be supported)
+        bool enable_jit(bool enabled);
+
+        [[nodiscard]] bool jit_enabled() const noexcept;
+
+        [[nodiscard]] uint64_t cycles() const noexcept;
+
+        [[nodiscard]] uint64_t instructions() const noexcept;
+
+        [[nodiscard]] regs &registers() noexcept {
+            return _regs;
+        }
+
+        [[nodiscard]] regs const &registers() const noexcept {
+            return _regs;
+        }
+
+        [[nodiscard]] block_cache const &blocks() const noexcept;
+
+        // number of blocks translated by the jit, 0 when it is disabled
+        [[nodiscard]] uint64_t translated_blocks() const noexcept;
+
+    private:
+        cpu_mem_bus &_membus;
+        scheduler &_scheduler;
+        regs _regs{};
+        block_cache _blocks;
+        execute _execute;
+        std::unique_ptr<jit> _jit;
+        // the block being executed, and the pc the next instruction of the block is at
+        block_cache::block const *_block{nullptr};
+        std::size_t _index{0};
+        uint16_t _next_pc{0};
+        // the instruction decoded outside of the cache while tracing
+        decoded_op _traced{};
+        uint64_t _instructions{0};
+
+        // the next instruction, from the block cache unless the bus is traced
+        decoded_op const &fetch_next();
+
+        // step() without catching the ppu and the apu up
+        void execute_next();
+
+        // run a translated block, return false when the interpreter has to step instead
+        bool run_jit();
+
+        // a held irq line is served as soon as the I flag is cleared
+        [[nodiscard]] bool irq_unmasked() const noexcept {
+            return _scheduler.irq_held() && !(_regs.sr & flag::irq_disable);
+        }
+
+        // the interrupt controller: once the scheduler has an event due, serve the nmi or the irq
+        uint8_t poll_interrupts();
+    };
+}
+
+#endif //NES_CPP_CPU_H
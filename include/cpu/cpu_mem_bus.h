@@ -5,17 +5,25 @@
 #ifndef NES_CPP_CPU_MEM_BUS_H
 #define NES_CPP_CPU_MEM_BUS_H
 
+#include <array>
 #include <memory>
+
+#include <spdlog/spdlog.h>
+
+#include "apu/apu.h"
 #include "cartridge/cartridge.h"
+#include "cpu/bus_trace.h"
+#include "cpu/scheduler.h"
+#include "input/controller.h"
 #include "memory/memory_interface.h"
+#include "ppu/ppu.h"
 
 namespace nes::cpu {
-    struct cpu_mem_bus_impl;
-
     enum class mem_type {
         internal,
         cartridge,
         ppu,
+        apu,
         none
     };
 
@@ -24,27 +32,259 @@ namespace nes::cpu {
             return mem_type::internal;
         else if (addr < 0x4000)
             return mem_type::ppu;
-        else if (addr > 0x4000)
+        else if (addr < 0x4018)
+            return mem_type::apu;
+        else if (addr >= 0x4020)
             return mem_type::cartridge;
         else
             return mem_type::none;
     }
 
-    class cpu_mem_bus : public memory::memory_iface {
+    // The bus is parameterized on the cartridge type so that the cartridge calls are resolved at
+    // compile time. Addresses are dispatched through a table of 256-byte pages: ram mirrors, prg-ram
+    // and prg-rom pages point straight at host memory, the others (ppu, apu/io, mapper registers)
+    // are routed to the io path according to their mem_type, the page at $4000 by the apu/io registers
+    // and the controller ports.
+    // Bank switches only rewrite page entries. The io path is also where the ppu and the apu are caught
+    // up with the master clock of the scheduler.
+    template<typename Mapper>
+    class basic_cpu_mem_bus final : public memory::memory_iface {
     public:
-        explicit cpu_mem_bus(std::shared_ptr<cartridge::cartridge> cartridge) noexcept;
-        ~cpu_mem_bus();
-        cpu_mem_bus(cpu_mem_bus const&) = delete;
-        cpu_mem_bus& operator=(cpu_mem_bus const&) = delete;
+        basic_cpu_mem_bus(Mapper &cartridge, ppu::ppu &ppu, apu::apu &apu, input::controllers &controllers,
+                          scheduler &scheduler) noexcept:
+                _cartridge(cartridge), _ppu(ppu), _apu(apu), _controllers(controllers), _scheduler(scheduler) {
+            for (unsigned page = 0; page < 0x100; page++)
+                _io_pages[page] = addr_to_mem_type(page << 8u);
+
+            for (unsigned page = 0x00; page < 0x20; page++) {
+                _read_pages[page] = &_internal_ram[(page & 0x07u) << 8u];
+                _write_pages[page] = writable_page(page);
+            }
+
+            map_cartridge();
+        }
+
+        ~basic_cpu_mem_bus() = default;
+
+        basic_cpu_mem_bus(basic_cpu_mem_bus const &) = delete;
+
+        basic_cpu_mem_bus &operator=(basic_cpu_mem_bus const &) = delete;
+
+        uint8_t fetch_u8(std::uint16_t addr) const final {
+            auto page = _read_pages[addr >> 8u];
+            auto value = page ? page[addr & 0xffu] : fetch_io(addr);
+            SPDLOG_TRACE("fetch u8 {} at {}", value, addr);
+            NES_TRACE_BUS(_trace, addr, value, bus_access::read);
+            return value;
+        }
+
+        uint16_t fetch_u16(std::uint16_t addr) const final {
+            return fetch_u8(addr) | (fetch_u8(addr + 1) << 8u);
+        }
+
+        void store(std::uint16_t addr, std::uint8_t data) final {
+            SPDLOG_TRACE("store u8 {} at {}", data, addr);
+            NES_TRACE_BUS(_trace, addr, data, bus_access::write);
+            auto page = _write_pages[addr >> 8u];
+            if (page) [[likely]] {
+                page[addr & 0xffu] = data;
+                return;
+            }
+            store_io(addr, data);
+        }
+
+        void store(std::uint16_t addr, std::uint16_t data) final {
+            store(addr, static_cast<uint8_t>(data & 0xffu));
+            store(static_cast<uint16_t>(addr + 1), static_cast<uint8_t>(data >> 8u));
+        }
+
+        [[nodiscard]] std::span<uint8_t const> data() const final {
+            return _internal_ram;
+        }
+
+        // refresh the $6000-$ffff pages from the cartridge, to be called after a bank switch
+        void map_cartridge() noexcept {
+            for (unsigned page = 0x60; page < 0x100; page++) {
+                _read_pages[page] = _cartridge.prg_page(page);
+                _write_pages[page] = _watched[page] ? nullptr : writable_page(page);
+            }
+        }
+
+        // host memory backing a cpu page, to key caches on what is actually mapped
+        [[nodiscard]] uint8_t const *read_page(uint8_t page) const noexcept {
+            return _read_pages[page];
+        }
+
+        // Stop the direct writes to a ram page (and its mirrors) holding code: stores then go through
+        // store_io, which bumps the page generation so that decoded code from it can be dropped.
+        void watch_page(uint8_t page) noexcept {
+            if (!_write_pages[page])
+                return;
+            auto mirrors = page < 0x20 ? 4u : 1u;
+            auto stride = page < 0x20 ? 0x08u : 0x00u;
+            for (unsigned i = 0; i < mirrors; i++) {
+                auto mirror = canonical_page(page) + i * stride;
+                _watched[mirror] = true;
+                _write_pages[mirror] = nullptr;
+            }
+        }
+
+        // number of writes to a watched page, mirrors included
+        [[nodiscard]] uint32_t page_generation(uint8_t page) const noexcept {
+            return _generations[canonical_page(page)];
+        }
 
-        uint8_t fetch_u8(std::uint16_t addr) const final;
-        uint16_t fetch_u16(std::uint16_t addr) const final;
-        void store(std::uint16_t addr, std::uint8_t data) final;
-        void store(std::uint16_t addr, std::uint16_t data) final;
-        [[nodiscard]] std::vector<uint8_t> const& data() const final;
+        // internal ram for save states. Loading drops every decoded block, and the cartridge must have
+        // been loaded first so that its banks are mapped again here.
+        void save(std::array<uint8_t, 0x800> &ram) const noexcept {
+            ram = _internal_ram;
+        }
+
+        void load(std::array<uint8_t, 0x800> const &ram) noexcept {
+            _internal_ram = ram;
+            for (auto &generation : _generations)
+                generation++;
+            map_cartridge();
+        }
+
+        // record every bus access into trace, nullptr to stop tracing. Only effective in NES_TRACE builds.
+        void set_trace(bus_trace *trace) noexcept {
+            _trace = trace;
+        }
+
+        // a trace is attached and recorded, never in builds without NES_TRACE
+        [[nodiscard]] bool tracing() const noexcept {
+#if NES_TRACE
+            return _trace != nullptr;
+#else
+            return false;
+#endif
+        }
 
     private:
-        std::unique_ptr<cpu_mem_bus_impl> _impl;
+        static constexpr uint8_t canonical_page(uint8_t page) noexcept {
+            return page < 0x20 ? page & 0x07u : page;
+        }
+
+        [[nodiscard]] uint8_t *writable_page(uint8_t page) noexcept {
+            if (page < 0x20)
+                return &_internal_ram[(page & 0x07u) << 8u];
+            return page >= 0x60 ? _cartridge.prg_ram_page(page) : nullptr;
+        }
+
+        uint8_t fetch_io(std::uint16_t addr) const;
+
+        void store_io(std::uint16_t addr, std::uint8_t data);
+
+        // Copy a cpu page to the ppu oam in one go, straight from host memory unless the page is io
+        // mapped or the bus is traced. The cpu is halted for 513 cycles, one more to align on an even cycle.
+        void oam_dma(std::uint8_t page) {
+            std::array<uint8_t, 0x100> io_page;
+            auto source = _read_pages[page];
+            if (!source || tracing()) {
+                for (unsigned i = 0; i < io_page.size(); i++)
+                    io_page[i] = fetch_u8(static_cast<uint16_t>((page << 8u) | i));
+                source = io_page.data();
+            }
+
+            _scheduler.sync_ppu();
+            _ppu.write_oam(std::span<uint8_t const, 0x100>(source, 0x100));
+            _scheduler.advance(513u + (_scheduler.now() & 1u));
+        }
+
+        std::array<uint8_t const *, 0x100> _read_pages{};
+        std::array<uint8_t *, 0x100> _write_pages{};
+        std::array<mem_type, 0x100> _io_pages{};
+        std::array<bool, 0x100> _watched{};
+        std::array<uint32_t, 0x100> _generations{};
+        std::array<uint8_t, 0x800> _internal_ram{};
+        Mapper &_cartridge;
+        ppu::ppu &_ppu;
+        apu::apu &_apu;
+        input::controllers &_controllers;
+        scheduler &_scheduler;
+        bus_trace *_trace{nullptr};
     };
+
+    template<typename Mapper>
+    uint8_t basic_cpu_mem_bus<Mapper>::fetch_io(std::uint16_t addr) const {
+        switch (_io_pages[addr >> 8u]) {
+            case mem_type::cartridge:
+                return _cartridge.fetch_u8(addr);
+            case mem_type::ppu:
+                _scheduler.sync_ppu();
+                return _ppu.fetch_register(addr);
+            case mem_type::apu: {
+                // the rest of the page is cartridge space
+                if (addr >= 0x4020)
+                    return _cartridge.fetch_u8(addr);
+                if (addr == 0x4016 || addr == 0x4017)
+                    return _controllers.fetch_register(addr);
+                _scheduler.sync_apu();
+                // reading the status acknowledges the frame irq
+                auto value = _apu.fetch_register(addr);
+                _scheduler.reschedule_apu();
+                return value;
+            }
+            case mem_type::internal:
+            case mem_type::none:
+                spdlog::error("invalid address in cpu_mem_bus");
+                break;
+        }
+
+        return 0;
+    }
+
+    template<typename Mapper>
+    void basic_cpu_mem_bus<Mapper>::store_io(std::uint16_t addr, std::uint8_t data) {
+        auto page = static_cast<uint8_t>(addr >> 8u);
+        if (_watched[page]) {
+            if (auto target = writable_page(page)) {
+                target[addr & 0xffu] = data;
+                _generations[canonical_page(page)]++;
+                return;
+            }
+        }
+
+        switch (_io_pages[addr >> 8u]) {
+            case mem_type::cartridge:
+                // mapper registers switch chr banks and mirroring under the ppu, and drive its irq
+                _scheduler.sync_ppu();
+                _cartridge.store(addr, data);
+                _scheduler.reschedule_ppu();
+                if (addr >= 0x8000)
+                    map_cartridge();
+                break;
+            case mem_type::ppu:
+                _scheduler.sync_ppu();
+                _ppu.store_register(addr, data);
+                _scheduler.reschedule_ppu();
+                break;
+            case mem_type::apu:
+                if (addr >= 0x4020) {
+                    _scheduler.sync_ppu();
+                    _cartridge.store(addr, data);
+                    _scheduler.reschedule_ppu();
+                } else if (addr == 0x4014) {
+                    oam_dma(data);
+                } else if (addr == 0x4016) {
+                    _controllers.store_register(data);
+                } else {
+                    // $4017 is the frame counter of the apu on writes
+                    _scheduler.sync_apu();
+                    _apu.store_register(addr, data);
+                    _scheduler.reschedule_apu();
+                }
+                break;
+            case mem_type::internal:
+            case mem_type::none:
+                spdlog::error("invalid address in cpu_mem_bus");
+                break;
+        }
+    }
+
+    extern template class basic_cpu_mem_bus<cartridge::cartridge>;
+
+    using cpu_mem_bus = basic_cpu_mem_bus<cartridge::cartridge>;
 }
 #endif //NES_CPP_CPU_MEM_BUS_H
@@ -5,7 +5,9 @@
 #ifndef NES_CPP_DECODER_H
 #define NES_CPP_DECODER_H
 
+#include <optional>
 #include <string_view>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 #include "cpu/regs.h"
@@ -13,29 +15,36 @@
 
 namespace nes::cpu {
 
-    enum class opcode {
+    enum class opcode : uint8_t {
         BRK, BPL, JSR, BMI, RTI, BVC, RTS, BVS, BCC, LDY, BCS, CPY, BNE, CPX, BEQ, BIT,
         STY, ORA, AND, EOR, ADC, STA, LDA, CMP, SBC, ASL, ROL, LSR, ROR, STX, LDX, DEC,
         INC, PHP, CLC, PLP, SEC, PHA, CLI, PLA, SEI, DEY, CLV, TAY, TYA, JMP, INY, CLD,
-        INX, SED, TXA, TAX, TXS, NOP, DEX, TSX
+        INX, SED, TXA, TAX, TXS, NOP, DEX, TSX,
+        ILL
     };
 
-    enum class address_mode {
+    enum class address_mode : uint8_t {
         Acc, Abs, AbsX, AbsY, Imm, Ind, XInd,
         IndY, Rel, Zpg, ZpgX, ZpgY, Impl
     };
 
     class decoded_op_impl;
 
+    // An instruction as it is encoded, independent of the registers and of the memory it operates
+    // on: it can be cached as long as the bytes it was decoded from do not change. The effective
+    // address of the indexed and indirect modes, the page crossing penalty and the operand value
+    // are left to the execute stage.
     struct decoded_op {
-        opcode op;
-        address_mode mode;
-        uint8_t cycles;
-        uint8_t bytes;
-        bool boundary_hint;
-        bool page_hint;
-        uint16_t addr;
-        uint8_t val;
+        opcode op{opcode::ILL};
+        address_mode mode{address_mode::Impl};
+        uint8_t cycles{0};
+        uint8_t bytes{0};
+        bool boundary_hint{false};
+        bool page_hint{false};
+        // the address when it is known from the instruction alone: Abs, Zpg, Imm and the Rel target
+        uint16_t addr{0};
+        // the bytes following the opcode, little endian
+        uint16_t operand{0};
     };
 
     class decoder {
@@ -48,10 +57,14 @@ namespace nes::cpu {
 
         decoder &operator=(decoder const &) = delete;
 
-        decoded_op decode(uint16_t addr, std::shared_ptr<regs> regs, std::shared_ptr<cpu_mem_bus> membus);
+        // only reads the instruction bytes at addr
+        static decoded_op decode(uint16_t addr, cpu_mem_bus const &membus);
 
-        std::vector<decoded_op>
-        decode(uint8_t nb_instr, uint16_t addr, std::shared_ptr<regs> regs, std::shared_ptr<cpu_mem_bus> membus);
+        static std::vector<decoded_op> decode(uint8_t nb_instr, uint16_t addr, cpu_mem_bus const &membus);
+
+        // decode from the host memory behind the bus, for debuggers: nothing is fetched, so io registers
+        // and bus traces never see it. nullopt when the instruction is not in directly mapped pages.
+        static std::optional<decoded_op> peek(uint16_t addr, cpu_mem_bus const &membus) noexcept;
     };
 
 
@@ -169,6 +182,8 @@ namespace nes::cpu {
                 return "DEX";
             case opcode::TSX:
                 return "TSX";
+            case opcode::ILL:
+                return "ILL";
         }
     }
 }
@@ -186,30 +201,29 @@ struct fmt::formatter<nes::cpu::decoded_op> {
             case nes::cpu::address_mode::Impl:
                 return format_to(ctx.out(), "{}", nes::cpu::opcode2string(p.op));
             case nes::cpu::address_mode::Imm :
-                return format_to(ctx.out(), "{} {:#04x}", nes::cpu::opcode2string(p.op), p.val);
+                return format_to(ctx.out(), "{} #{:#04x}", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::Abs :
-                return format_to(ctx.out(), "{}[{:#06x}] = {:#04x}", nes::cpu::opcode2string(p.op), p.addr, p.val);
+                return format_to(ctx.out(), "{} {:#06x}", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::AbsX:
-                return format_to(ctx.out(), "{}[{:#06x}] = {:#04x}", nes::cpu::opcode2string(p.op), p.addr, p.val);
+                return format_to(ctx.out(), "{} {:#06x},x", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::AbsY:
-                return format_to(ctx.out(), "{}[{:#06x},y] = {:#04x}", nes::cpu::opcode2string(p.op), p.addr, p.val);
+                return format_to(ctx.out(), "{} {:#06x},y", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::Zpg :
-                return format_to(ctx.out(), "{}[{:#06x}] = {:#04x}", nes::cpu::opcode2string(p.op), p.addr, p.val);
+                return format_to(ctx.out(), "{} {:#04x}", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::ZpgX:
-                return format_to(ctx.out(), "{}[{:#06x},x] = {:#04x}", nes::cpu::opcode2string(p.op), p.addr, p.val);
+                return format_to(ctx.out(), "{} {:#04x},x", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::ZpgY:
-                return format_to(ctx.out(), "{}[{:#06x},y] = {:#04x}", nes::cpu::opcode2string(p.op), p.addr, p.val);
+                return format_to(ctx.out(), "{} {:#04x},y", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::Ind :
-                return format_to(ctx.out(), "{}", nes::cpu::opcode2string(p.op));
+                return format_to(ctx.out(), "{} ({:#06x})", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::XInd:
-                return format_to(ctx.out(), "{}", nes::cpu::opcode2string(p.op));
+                return format_to(ctx.out(), "{} ({:#04x},x)", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::IndY:
-                return format_to(ctx.out(), "{}", nes::cpu::opcode2string(p.op));
+                return format_to(ctx.out(), "{} ({:#04x}),y", nes::cpu::opcode2string(p.op), p.operand);
             case nes::cpu::address_mode::Acc :
-                return format_to(ctx.out(), "{}", nes::cpu::opcode2string(p.op));
+                return format_to(ctx.out(), "{} A", nes::cpu::opcode2string(p.op));
             case nes::cpu::address_mode::Rel:
-                return format_to(ctx.out(), "{} PC{:+} = {:#04x}", nes::cpu::opcode2string(p.op),
-                                 static_cast<int8_t>(p.addr), p.val);
+                return format_to(ctx.out(), "{} {:#06x}", nes::cpu::opcode2string(p.op), p.addr);
         }
     }
 };
@@ -5,26 +5,143 @@
 #ifndef NES_CPP_EXECUTE_H
 #define NES_CPP_EXECUTE_H
 
-#include <memory>
-
 #include "cpu/cpu_mem_bus.h"
 #include "cpu/decoder.h"
 #include "cpu/regs.h"
 
 namespace nes::cpu {
-    class execute_impl;
 
+    // The interpreter stage: works directly on the registers and the bus of the console it belongs to.
     class execute {
     public:
-        execute(std::shared_ptr<cpu_mem_bus> membus, std::shared_ptr<regs> regs);
-        ~execute(void);
-        execute(execute const&) = delete;
-        execute& operator=(execute const&) = delete;
+        execute(cpu_mem_bus &membus, regs &regs) noexcept;
+
+        ~execute() = default;
+
+        execute(execute const &) = delete;
+
+        execute &operator=(execute const &) = delete;
+
+        // resolve the operand of op against the registers and memory, then execute it. pc must already
+        // point past the instruction. Return the number of cycles it took, penalties included.
+        uint8_t exec(decoded_op const &op);
 
-        uint8_t exec(decoded_op &op);
+        // push pc and sr then jump through vector, return the number of cycles it took
+        uint8_t interrupt(uint16_t vector);
 
     private:
-        std::unique_ptr<execute_impl> _impl;
+        void set_flag(uint8_t flag, bool value) noexcept {
+            if (value)
+                _regs.sr |= flag;
+            else
+                _regs.sr &= static_cast<uint8_t>(~flag);
+        }
+
+        void set_nz(uint8_t value) noexcept {
+            set_flag(flag::zero, value == 0);
+            set_flag(flag::negative, value & 0x80u);
+        }
+
+        void push(uint8_t value) {
+            _membus.store(static_cast<uint16_t>(0x100u | _regs.sp), value);
+            _regs.sp--;
+        }
+
+        void push16(uint16_t value) {
+            push(static_cast<uint8_t>(value >> 8u));
+            push(static_cast<uint8_t>(value & 0xffu));
+        }
+
+        uint8_t pull() {
+            _regs.sp++;
+            return _membus.fetch_u8(static_cast<uint16_t>(0x100u | _regs.sp));
+        }
+
+        uint16_t pull16() {
+            uint16_t lo = pull();
+            return lo | (pull() << 8u);
+        }
+
+        void adc(uint8_t value) noexcept {
+            uint16_t sum = _regs.ac + value + (_regs.sr & flag::carry);
+            set_flag(flag::carry, sum > 0xff);
+            set_flag(flag::overflow, ~(_regs.ac ^ value) & (_regs.ac ^ sum) & 0x80u);
+            _regs.ac = static_cast<uint8_t>(sum);
+            set_nz(_regs.ac);
+        }
+
+        void compare(uint8_t reg, uint8_t value) noexcept {
+            set_flag(flag::carry, reg >= value);
+            set_nz(static_cast<uint8_t>(reg - value));
+        }
+
+        // branches cost one more cycle when taken, and another one when the target is on a different page
+        uint8_t branch(decoded_op const &op, bool taken) noexcept {
+            if (!taken)
+                return op.cycles;
+
+            uint8_t cycles = op.cycles + 1;
+            if ((_regs.pc & 0xff00u) != (op.addr & 0xff00u))
+                cycles++;
+            _regs.pc = op.addr;
+            return cycles;
+        }
+
+        // shifts and rotates work either on the accumulator or in place in memory
+        template<typename Fn>
+        void read_modify_write(decoded_op const &op, uint16_t addr, Fn &&fn) {
+            if (op.mode == address_mode::Acc) {
+                _regs.ac = fn(_regs.ac);
+            } else {
+                _membus.store(addr, static_cast<uint8_t>(fn(_membus.fetch_u8(addr))));
+            }
+        }
+
+        // zero page pointers wrap inside the zero page
+        [[nodiscard]] uint16_t zpg_pointer(uint8_t ptr) const {
+            return _membus.fetch_u8(ptr) | (_membus.fetch_u8(static_cast<uint8_t>(ptr + 1)) << 8u);
+        }
+
+        // effective address of the memory operand, cycles gets the page crossing penalty
+        uint16_t address(decoded_op const &op, uint8_t &cycles) const {
+            auto indexed = [&op, &cycles](uint16_t base, uint8_t idx) -> uint16_t {
+                uint16_t addr = base + idx;
+                if (op.boundary_hint && (base & 0xff00u) != (addr & 0xff00u))
+                    cycles++;
+                return addr;
+            };
+
+            switch (op.mode) {
+                case address_mode::AbsX:
+                    return indexed(op.operand, _regs.x);
+                case address_mode::AbsY:
+                    return indexed(op.operand, _regs.y);
+                case address_mode::ZpgX:
+                    return static_cast<uint8_t>(op.operand + _regs.x);
+                case address_mode::ZpgY:
+                    return static_cast<uint8_t>(op.operand + _regs.y);
+                case address_mode::Ind:
+                    // the 6502 does not carry into the high byte of the pointer
+                    return _membus.fetch_u8(op.operand) |
+                           (_membus.fetch_u8((op.operand & 0xff00u) | ((op.operand + 1) & 0x00ffu)) << 8u);
+                case address_mode::XInd:
+                    return zpg_pointer(static_cast<uint8_t>(op.operand + _regs.x));
+                case address_mode::IndY:
+                    return indexed(zpg_pointer(static_cast<uint8_t>(op.operand)), _regs.y);
+                default:
+                    return op.addr;
+            }
+        }
+
+        // the one read of the operand an instruction does
+        [[nodiscard]] uint8_t read(decoded_op const &op, uint16_t addr) const {
+            if (op.mode == address_mode::Imm)
+                return static_cast<uint8_t>(op.operand);
+            return _membus.fetch_u8(addr);
+        }
+
+        cpu_mem_bus &_membus;
+        regs &_regs;
     };
 }
 
@@ -0,0 +1,56 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_JIT_H
+#define NES_CPP_JIT_H
+
+#include <cstdint>
+#include <memory>
+
+#include "cpu/block_cache.h"
+#include "cpu/cpu_mem_bus.h"
+#include "cpu/regs.h"
+#include "cpu/scheduler.h"
+
+namespace nes::cpu {
+    struct jit_impl;
+
+    // Translate hot prg-rom blocks of the block cache into x86-64 code. The 6502 registers live in
+    // host registers for the duration of a block, memory accesses outside of the internal ram go
+    // through the bus, and the master clock is brought up to the block cycle counter before every io
+    // access.
+    // Blocks end before BRK, RTI, JMP (ind) and illegal opcodes, which are left to the interpreter,
+    // as is code running from ram. Only available on x86-64 unix hosts, and not in NES_TRACE builds.
+    class jit {
+    public:
+        jit(regs &regs, cpu_mem_bus &membus, scheduler &scheduler, block_cache &blocks);
+
+        ~jit();
+
+        jit(jit const &) = delete;
+
+        jit &operator=(jit const &) = delete;
+
+        [[nodiscard]] static bool supported() noexcept;
+
+        // execute the translated block at pc, translating it first once it is hot. Return the number of
+        // instructions executed, 0 when the interpreter has to step instead.
+        uint32_t run();
+
+        // cycles taken by the last run, and how many of them the clock has already been advanced by
+        [[nodiscard]] uint64_t cycles() const noexcept;
+
+        [[nodiscard]] uint64_t synced() const noexcept;
+
+        [[nodiscard]] uint64_t translated_blocks() const noexcept;
+
+        // drop every translation
+        void clear() noexcept;
+
+    private:
+        std::unique_ptr<jit_impl> _impl;
+    };
+}
+
+#endif //NES_CPP_JIT_H
@@ -9,6 +9,18 @@
 
 namespace nes::cpu {
 
+    // status register (sr) bits
+    namespace flag {
+        constexpr uint8_t carry{0x01};
+        constexpr uint8_t zero{0x02};
+        constexpr uint8_t irq_disable{0x04};
+        constexpr uint8_t decimal{0x08};
+        constexpr uint8_t brk{0x10};
+        constexpr uint8_t unused{0x20};
+        constexpr uint8_t overflow{0x40};
+        constexpr uint8_t negative{0x80};
+    }
+
     struct regs {
         uint16_t pc{0x00};
         uint8_t ac{0x00};
@@ -16,7 +28,6 @@ namespace nes::cpu {
         uint8_t y{0x00};
         uint8_t sr{0x00};
         uint8_t sp{0x00};
-        uint8_t flags{0x00};
     };
 };
 
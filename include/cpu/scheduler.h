@@ -0,0 +1,125 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_SCHEDULER_H
+#define NES_CPP_SCHEDULER_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "apu/apu.h"
+#include "cartridge/cartridge.h"
+#include "ppu/ppu.h"
+
+namespace nes::cpu {
+
+    // the parts able to interrupt the cpu, each one has at most one predicted event at a time
+    enum class event_source : uint8_t {
+        nmi,
+        mapper_irq,
+        apu_irq,
+        dmc_dma
+    };
+
+    // interrupt lines seen by the cpu when polling the scheduler
+    struct interrupts {
+        bool nmi{false};
+        bool irq{false};
+    };
+
+    // The master clock, in cpu cycles. The cpu runs ahead and only advances the clock; the ppu and the
+    // apu are caught up with it when the bus touches their registers or the cartridge banks the ppu
+    // reads from, and when the clock reaches the next event they predicted: the nmi at the start of
+    // vblank, the mapper scanline irq, the apu frame and dmc irqs, and the dmc sample reads that halt
+    // the cpu. Events are kept in a min-heap, the cpu only compares the clock with the earliest one
+    // between instructions.
+    class scheduler {
+    public:
+        scheduler(cartridge::cartridge &cartridge, ppu::ppu &ppu, apu::apu &apu);
+
+        ~scheduler() = default;
+
+        scheduler(scheduler const &) = delete;
+
+        scheduler &operator=(scheduler const &) = delete;
+
+        // put the ppu and the apu in their power-up state, with the clock at now
+        void reset(uint64_t now);
+
+        // restart the clock at now, the ppu and the apu already being at that point (loaded from a state)
+        void rebase(uint64_t now);
+
+        // count the cycles executed by the cpu, or the cycles it is halted for by a dma, return true
+        // once the earliest event is due
+        bool advance(uint64_t cycles) noexcept {
+            _now += cycles;
+            return _now >= _deadline;
+        }
+
+        // catch the ppu up with the clock and predict its events
+        void sync_ppu();
+
+        // catch the apu up with the clock, charge the dmc reads to the cpu and predict its events
+        void sync_apu();
+
+        void sync();
+
+        // predict the events of a part again, after a register write that may have moved them
+        void reschedule_ppu();
+
+        void reschedule_apu();
+
+        // catch up the parts whose events are due, take the nmi edge and sample the irq line
+        interrupts poll();
+
+        // whether the irq line was high at the last poll. A held line is not predicted again: the cpu
+        // polls once more when its I flag is clear, to be served or to find that it was acknowledged.
+        [[nodiscard]] bool irq_held() const noexcept {
+            return _irq_held;
+        }
+
+        [[nodiscard]] uint64_t now() const noexcept {
+            return _now;
+        }
+
+        [[nodiscard]] uint64_t deadline() const noexcept {
+            return _deadline;
+        }
+
+    private:
+        struct event {
+            uint64_t time;
+            event_source source;
+        };
+
+        void run_ppu() {
+            _ppu.run((_now - _ppu_time) * 3u);
+            _ppu_time = _now;
+        }
+
+        // the dmc reads move the clock past the apu, it runs that far at the next sync
+        void run_apu() {
+            _apu.run(_now - _apu_time);
+            _apu_time = _now;
+            _now += _apu.take_dma_stall();
+        }
+
+        // an event superseded by a later prediction stays in the heap and is dropped once due
+        void schedule(event_source source, uint64_t time);
+
+        cartridge::cartridge &_cartridge;
+        ppu::ppu &_ppu;
+        apu::apu &_apu;
+        uint64_t _now{0};
+        uint64_t _ppu_time{0};
+        uint64_t _apu_time{0};
+        uint64_t _deadline{0};
+        bool _irq_held{false};
+        std::vector<event> _events;
+        std::array<uint64_t, 4> _due{};
+    };
+}
+
+#endif //NES_CPP_SCHEDULER_H
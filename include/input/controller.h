@@ -0,0 +1,64 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_CONTROLLER_H
+#define NES_CPP_CONTROLLER_H
+
+#include <array>
+#include <cstdint>
+
+namespace nes::input {
+
+    // bit of each button in a port state, in the order the shift register reports them
+    namespace button {
+        constexpr uint8_t a{0x01};
+        constexpr uint8_t b{0x02};
+        constexpr uint8_t select{0x04};
+        constexpr uint8_t start{0x08};
+        constexpr uint8_t up{0x10};
+        constexpr uint8_t down{0x20};
+        constexpr uint8_t left{0x40};
+        constexpr uint8_t right{0x80};
+    }
+
+    // buttons held and shift registers, in the fixed layout of save states
+    struct controller_state {
+        std::array<uint8_t, 2> buttons{};
+        std::array<uint8_t, 2> shift{};
+        bool strobe{false};
+    };
+
+    // The two standard controllers behind $4016 and $4017. While bit 0 of $4016 is set the shift
+    // registers keep reloading the buttons held; once it is cleared each read returns the next
+    // button in bit 0, A first, then 1s after the 8 buttons.
+    class controllers {
+    public:
+        controllers() = default;
+
+        ~controllers() = default;
+
+        controllers(controllers const &) = delete;
+
+        controllers &operator=(controllers const &) = delete;
+
+        void set_buttons(unsigned port, uint8_t buttons) noexcept;
+
+        [[nodiscard]] uint8_t buttons(unsigned port) const noexcept;
+
+        // $4016 for port 0, $4017 for port 1
+        uint8_t fetch_register(uint16_t addr) noexcept;
+
+        // $4016, the strobe of both ports
+        void store_register(uint8_t data) noexcept;
+
+        void save(controller_state &state) const noexcept;
+
+        void load(controller_state const &state) noexcept;
+
+    private:
+        controller_state _s{};
+    };
+}
+
+#endif //NES_CPP_CONTROLLER_H
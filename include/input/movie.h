@@ -0,0 +1,73 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_MOVIE_H
+#define NES_CPP_MOVIE_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace nes::input {
+
+    class movie_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // the input of one frame: buttons of both ports, and whether the console is reset before the frame
+    struct movie_frame {
+        std::array<uint8_t, 2> buttons{};
+        bool reset{false};
+    };
+
+    // Per frame input log in the FM2 text format of FCEUX: "key value" header lines, then one
+    // "|commands|RLDUTSBA|RLDUTSBA||" line per frame where any character but ' ' and '.' is a button
+    // held. Only the two standard controllers and the reset commands are kept. A movie plays from
+    // power-on, each line is applied as the ppu enters vblank and lasts until the next one.
+    class movie {
+    public:
+        movie() = default;
+
+        // throws movie_error when the file cannot be read or a frame line is malformed
+        explicit movie(std::filesystem::path const &path);
+
+        // throws movie_error when the file cannot be written
+        void save(std::filesystem::path const &path) const;
+
+        void record(movie_frame const &frame) {
+            _frames.push_back(frame);
+        }
+
+        void clear() noexcept {
+            _frames.clear();
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return _frames.size();
+        }
+
+        [[nodiscard]] movie_frame const &operator[](std::size_t frame) const noexcept {
+            return _frames[frame];
+        }
+
+        // name of the rom the movie was recorded on, informative only
+        [[nodiscard]] std::string const &rom_name() const noexcept {
+            return _rom_name;
+        }
+
+        void set_rom_name(std::string name) {
+            _rom_name = std::move(name);
+        }
+
+    private:
+        std::string _rom_name;
+        std::vector<movie_frame> _frames;
+    };
+}
+
+#endif //NES_CPP_MOVIE_H
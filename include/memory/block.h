@@ -1,4 +1,6 @@
 #include <memory>
+#include <vector>
+
 #include "memory_interface.h"
 
 namespace nes::memory {
@@ -16,7 +18,7 @@ namespace nes::memory {
         uint16_t fetch_u16(std::uint16_t addr) const final;
         void store(std::uint16_t addr, std::uint8_t data) final;
         void store(std::uint16_t addr, std::uint16_t data) final;
-        [[nodiscard]] std::vector<uint8_t> const& data() const final;
+        [[nodiscard]] std::span<uint8_t const> data() const final;
 
     private:
         std::unique_ptr<block_impl> _impl;
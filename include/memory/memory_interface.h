@@ -5,6 +5,9 @@
 #ifndef NES_CPP_MEMORY_INTERFACE_H
 #define NES_CPP_MEMORY_INTERFACE_H
 
+#include <cstdint>
+#include <span>
+
 namespace nes::memory {
 
     class memory_iface {
@@ -17,7 +20,7 @@ namespace nes::memory {
         void dump() const noexcept { };
         void dump_slice(std::uint16_t begin, std::uint16_t end) const noexcept {};
 
-        virtual std::vector<uint8_t> const& data() const = 0;
+        virtual std::span<uint8_t const> data() const = 0;
 
         virtual uint8_t fetch_u8(std::uint16_t addr) const = 0;
         virtual uint16_t fetch_u16(std::uint16_t addr) const = 0;
@@ -0,0 +1,52 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_CHR_CACHE_H
+#define NES_CPP_CHR_CACHE_H
+
+#include <array>
+#include <cstdint>
+
+#include "cartridge/mapper.h"
+#include "ppu/pixel_kernels.h"
+
+namespace nes::ppu {
+
+    // The 512 tiles of the ppu pattern tables, expanded to one byte (color 0-3) per pixel. A tile
+    // row is read as a 64 bits word, leftmost pixel in the first byte. Tiles are decoded lazily:
+    // sync() drops the 1k slots the mapper switched since the last call, invalidate() the tiles
+    // under a chr-ram write, everything else is served without touching the bitplanes.
+    class chr_cache {
+    public:
+        explicit chr_cache(pixel_kernels const &kernels) noexcept;
+
+        // compare the mapper chr banks with the ones the cache was filled from
+        void sync(cartridge::mapper const &board) noexcept;
+
+        // a chr-ram write at ppu address addr, invalidates every slot mapping the same memory
+        void invalidate(cartridge::mapper const &board, uint16_t addr) noexcept;
+
+        void clear() noexcept;
+
+        // 8 pixels of the pattern row at addr (tile * 16 + fine y, bit 3 ignored)
+        [[nodiscard]] uint64_t row(uint16_t addr) noexcept {
+            auto tile = (addr >> 4u) & 0x1ffu;
+            if (_dirty[tile]) [[unlikely]]
+                decode(tile);
+            return _rows[tile * 8 + (addr & 0x07u)];
+        }
+
+    private:
+        void decode(unsigned tile) noexcept;
+
+        static constexpr unsigned tiles_per_slot{0x400 / 16};
+
+        pixel_kernels const &_kernels;
+        std::array<uint8_t const *, 8> _banks{};
+        std::array<bool, 512> _dirty{};
+        std::array<uint64_t, 512 * 8> _rows{};
+    };
+}
+
+#endif //NES_CPP_CHR_CACHE_H
@@ -0,0 +1,46 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_PIXEL_KERNELS_H
+#define NES_CPP_PIXEL_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace nes::ppu {
+    enum class simd_level {
+        scalar,
+        ssse3,
+        avx2
+    };
+
+    std::string_view simd_level2string(simd_level level);
+
+    // The scanline renderer hot loops. Every implementation produces the same bytes, the vector ones
+    // handle several tiles (or pixels) per iteration and finish the tail with the scalar code.
+    struct pixel_kernels {
+        // expand tile rows from their two bitplanes: out[tile * 8 + px] = color ? palette[tile] | color : 0,
+        // palette being the attribute bits already shifted to bits 2-3
+        void (*decode_tiles)(uint8_t const *lo, uint8_t const *hi, uint8_t const *palette, std::size_t tiles,
+                             uint8_t *out);
+
+        // mux background and sprite pixels (see ppu.cpp for the sprite pixel layout), look the result
+        // up in the 32 entries palette ram and apply the grayscale mask
+        void (*compose)(uint8_t const *background, uint8_t const *sprites, uint8_t const *palette, uint8_t gray,
+                        std::size_t count, uint8_t *out);
+    };
+
+    // best level supported by the host cpu, detected once with cpuid
+    simd_level detect_simd() noexcept;
+
+    bool simd_supported(simd_level level) noexcept;
+
+    pixel_kernels const &kernels_for(simd_level level) noexcept;
+
+    // kernels for detect_simd()
+    pixel_kernels const &active_kernels() noexcept;
+}
+
+#endif //NES_CPP_PIXEL_KERNELS_H
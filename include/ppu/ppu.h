@@ -0,0 +1,104 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#ifndef NES_CPP_PPU_H
+#define NES_CPP_PPU_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "cartridge/cartridge.h"
+
+namespace nes::ppu {
+    struct ppu_impl;
+
+    constexpr int width{256};
+    constexpr int height{240};
+    constexpr int dots_per_scanline{341};
+    constexpr int scanlines_per_frame{262};
+
+    // registers, memories and beam position, in the fixed layout of save states. The framebuffer is
+    // not part of it, the next frame is rendered from this state alone.
+    struct ppu_state {
+        uint8_t ctrl{0};
+        uint8_t mask{0};
+        uint8_t status{0};
+        uint8_t oam_addr{0};
+        uint8_t read_buffer{0};
+        uint8_t open_bus{0};
+        uint8_t x{0};
+        bool w{false};
+        uint16_t v{0};
+        uint16_t t{0};
+        int16_t scanline{0};
+        int16_t dot{0};
+        int16_t sprite0_dot{-1};
+        bool nmi_edge{false};
+        uint64_t frame{0};
+        std::array<uint8_t, 0x1000> vram{};
+        std::array<uint8_t, 0x20> palette{};
+        std::array<uint8_t, 0x100> oam{};
+    };
+
+    // 2C02 picture processing unit. The ppu is advanced in batches of dots: it walks from one event
+    // (scanline start, scroll updates, vblank...) to the next and renders a whole scanline at once
+    // into a framebuffer of 6 bits palette values (see ntsc_palette).
+    class ppu {
+    public:
+        explicit ppu(cartridge::cartridge &cartridge);
+
+        ~ppu();
+
+        ppu(ppu const &) = delete;
+
+        ppu &operator=(ppu const &) = delete;
+
+        void reset();
+
+        // cpu side registers, $2000-$2007 mirrored up to $3fff
+        uint8_t fetch_register(uint16_t addr);
+
+        void store_register(uint16_t addr, uint8_t data);
+
+        // oam dma, the 256 bytes land as if written to $2004 one after the other
+        void write_oam(std::span<uint8_t const, 0x100> data) noexcept;
+
+        // advance by dots ppu cycles, 3 per cpu cycle
+        void run(uint64_t dots);
+
+        // true once for every rising edge of the nmi line
+        bool poll_nmi() noexcept;
+
+        // number of dots run() can advance by before the nmi line rises, 0 when an edge is pending and
+        // the maximum when nmis are disabled. It may be early by a dot, never late.
+        [[nodiscard]] uint64_t dots_to_nmi() const noexcept;
+
+        // same for the cartridge irq line, raised by the scanline counter of the mapper
+        [[nodiscard]] uint64_t dots_to_irq() const noexcept;
+
+        // number of dots run() can advance by before the next vblank starts a frame, early by a dot at most
+        [[nodiscard]] uint64_t dots_to_vblank() const noexcept;
+
+        // number of frames started, incremented at the beginning of vblank
+        [[nodiscard]] uint64_t frame() const noexcept;
+
+        [[nodiscard]] int scanline() const noexcept;
+
+        [[nodiscard]] int dot() const noexcept;
+
+        [[nodiscard]] std::span<uint8_t const> framebuffer() const noexcept;
+
+        void save(ppu_state &state) const noexcept;
+
+        // the cartridge must have been loaded first, the pattern tables are decoded again from it
+        void load(ppu_state const &state) noexcept;
+
+    private:
+        std::unique_ptr<ppu_impl> _impl;
+    };
+}
+
+#endif //NES_CPP_PPU_H
@@ -0,0 +1,586 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "apu/apu.h"
+#include "apu/blip_buffer.h"
+
+using namespace nes::apu;
+
+namespace {
+    using state = apu_state;
+
+    // ntsc cpu clock, the apu timers count cpu cycles
+    constexpr double clock_hz{1789773.0};
+    constexpr uint64_t never{std::numeric_limits<uint64_t>::max()};
+    constexpr std::size_t max_samples{sample_rate / 2};
+
+    constexpr std::array<uint8_t, 32> length_table{
+            10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+            12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30};
+
+    constexpr std::array<std::array<uint8_t, 8>, 4> duty_table{{
+            {0, 1, 0, 0, 0, 0, 0, 0},
+            {0, 1, 1, 0, 0, 0, 0, 0},
+            {0, 1, 1, 1, 1, 0, 0, 0},
+            {1, 0, 0, 1, 1, 1, 1, 1}}};
+
+    constexpr std::array<uint8_t, 32> triangle_table{
+            15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+    constexpr std::array<uint16_t, 16> noise_periods{
+            4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068};
+
+    // cpu cycles the dmc reader halts the cpu for while it fetches a sample byte
+    constexpr uint64_t dmc_stall{4};
+
+    constexpr std::array<uint16_t, 16> dmc_rates{
+            428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54};
+
+    // frame sequencer steps, in cpu cycles from the sequencer reset
+    constexpr std::array<uint64_t, 4> four_step{7457, 14913, 22371, 29829};
+    constexpr uint64_t four_step_period{29830};
+    constexpr std::array<uint64_t, 4> five_step{7457, 14913, 22371, 37281};
+    constexpr uint64_t five_step_period{37282};
+
+    // the non-linear mixer of the 2A03
+    constexpr auto pulse_table = [] {
+        std::array<float, 31> table{};
+        for (std::size_t n = 1; n < table.size(); n++)
+            table[n] = static_cast<float>(95.52 / (8128.0 / static_cast<double>(n) + 100.0));
+        return table;
+    }();
+
+    constexpr auto tnd_table = [] {
+        std::array<float, 203> table{};
+        for (std::size_t n = 1; n < table.size(); n++)
+            table[n] = static_cast<float>(163.67 / (24329.0 / static_cast<double>(n) + 100.0));
+        return table;
+    }();
+
+    uint8_t volume(state::envelope const &e) noexcept {
+        return e.constant ? e.volume : e.decay;
+    }
+
+    void clock_envelope(state::envelope &e) noexcept {
+        if (e.start) {
+            e.start = false;
+            e.decay = 15;
+            e.divider = e.volume;
+        } else if (e.divider == 0) {
+            e.divider = e.volume;
+            if (e.decay)
+                e.decay--;
+            else if (e.loop)
+                e.decay = 15;
+        } else {
+            e.divider--;
+        }
+    }
+
+    void store_envelope(state::envelope &e, uint8_t data) noexcept {
+        e.loop = data & 0x20u;
+        e.constant = data & 0x10u;
+        e.volume = data & 0x0fu;
+    }
+
+    // pulse 1 negates with one's complement, pulse 2 with two's complement
+    uint16_t sweep_target(state::pulse_channel const &p, bool ones_complement) noexcept {
+        uint16_t change = p.period >> p.sweep_shift;
+        if (!p.sweep_negate)
+            return p.period + change;
+        return static_cast<uint16_t>(p.period - change - (ones_complement ? 1 : 0));
+    }
+
+    bool muted(state::pulse_channel const &p, bool ones_complement) noexcept {
+        return p.period < 8 || sweep_target(p, ones_complement) > 0x7ff;
+    }
+
+    void clock_sweep(state::pulse_channel &p, bool ones_complement) noexcept {
+        if (p.sweep_divider == 0 && p.sweep_enabled && p.sweep_shift && !muted(p, ones_complement))
+            p.period = sweep_target(p, ones_complement);
+        if (p.sweep_divider == 0 || p.sweep_reload) {
+            p.sweep_divider = p.sweep_period;
+            p.sweep_reload = false;
+        } else {
+            p.sweep_divider--;
+        }
+    }
+
+    void clock_length(uint8_t &length, bool halt) noexcept {
+        if (length && !halt)
+            length--;
+    }
+
+    void store_pulse(state::pulse_channel &p, unsigned reg, uint8_t data) noexcept {
+        switch (reg) {
+            case 0:
+                p.duty = data >> 6u;
+                store_envelope(p.env, data);
+                break;
+            case 1:
+                p.sweep_enabled = data & 0x80u;
+                p.sweep_period = (data >> 4u) & 0x07u;
+                p.sweep_negate = data & 0x08u;
+                p.sweep_shift = data & 0x07u;
+                p.sweep_reload = true;
+                break;
+            case 2:
+                p.period = (p.period & 0x0700u) | data;
+                break;
+            default:
+                p.period = (p.period & 0x00ffu) | ((data & 0x07u) << 8u);
+                if (p.enabled)
+                    p.length = length_table[data >> 3u];
+                p.step = 0;
+                p.env.start = true;
+                break;
+        }
+    }
+}
+
+struct nes::apu::apu_impl {
+private:
+    cartridge::cartridge *_cartridge{nullptr};
+    state _s{};
+    bool _output{false};
+    uint64_t _dma_stall{0};
+
+    blip_buffer _blip{clock_hz, sample_rate, sample_rate / 30};
+    uint64_t _blip_start{0};
+    float _amplitude{0};
+    std::vector<int16_t> _samples;
+
+    // a channel only takes part in the catch up while its timer has an audible effect
+    [[nodiscard]] bool pulse_active(state::pulse_channel const &p, bool ones_complement) const noexcept {
+        return p.length && !muted(p, ones_complement);
+    }
+
+    [[nodiscard]] bool triangle_active() const noexcept {
+        // ultrasonic periods are silenced by freezing the sequencer
+        return _s.triangle.length && _s.triangle.linear && _s.triangle.period >= 2;
+    }
+
+    [[nodiscard]] bool dmc_active() const noexcept {
+        return _s.dmc.remaining || _s.dmc.buffer_full || !_s.dmc.silence;
+    }
+
+    // next edge of a timer, a timer that was idle restarts now
+    uint64_t next(uint64_t &clock, bool active) const noexcept {
+        if (!active)
+            return never;
+        if (clock < _s.time)
+            clock = _s.time;
+        return clock;
+    }
+
+    [[nodiscard]] uint64_t frame_event() const noexcept {
+        return _s.frame_start + (_s.five_step ? five_step : four_step)[_s.frame_step];
+    }
+
+    void quarter_frame() noexcept {
+        clock_envelope(_s.pulse1.env);
+        clock_envelope(_s.pulse2.env);
+        clock_envelope(_s.noise.env);
+
+        auto &t = _s.triangle;
+        if (t.linear_reload)
+            t.linear = t.linear_period;
+        else if (t.linear)
+            t.linear--;
+        if (!t.control)
+            t.linear_reload = false;
+    }
+
+    void half_frame() noexcept {
+        clock_length(_s.pulse1.length, _s.pulse1.env.loop);
+        clock_length(_s.pulse2.length, _s.pulse2.env.loop);
+        clock_length(_s.triangle.length, _s.triangle.control);
+        clock_length(_s.noise.length, _s.noise.env.loop);
+        clock_sweep(_s.pulse1, true);
+        clock_sweep(_s.pulse2, false);
+    }
+
+    void clock_frame_sequencer() noexcept {
+        quarter_frame();
+        if (_s.frame_step == 1 || _s.frame_step == 3)
+            half_frame();
+        if (_s.frame_step == 3) {
+            if (!_s.five_step && !_s.irq_inhibit)
+                _s.frame_irq = true;
+            _s.frame_start += _s.five_step ? five_step_period : four_step_period;
+            _s.frame_step = 0;
+        } else {
+            _s.frame_step++;
+        }
+    }
+
+    [[nodiscard]] uint64_t cycles_to_irq() const noexcept {
+        if (_s.frame_irq || _s.dmc.irq)
+            return 0;
+
+        auto cycles = never;
+        if (!_s.five_step && !_s.irq_inhibit)
+            cycles = _s.frame_start + four_step[3] - _s.time;
+
+        // the irq rises when the reader fetches the last byte, at the end of an output cycle
+        auto const &d = _s.dmc;
+        if (d.irq_enabled && !d.loop && d.remaining) {
+            if (!d.buffer_full)
+                return 0;
+            uint64_t rate = dmc_rates[d.rate];
+            auto clock = std::max(d.next_clock, _s.time) - _s.time;
+            cycles = std::min(cycles, clock + (d.bits - 1u) * rate + (d.remaining - 1u) * 8u * rate);
+        }
+        return cycles;
+    }
+
+    // the reader fetches the next byte when the output unit empties the buffer, at the end of a byte
+    [[nodiscard]] uint64_t cycles_to_dma() const noexcept {
+        auto const &d = _s.dmc;
+        if (!d.remaining)
+            return never;
+        uint64_t rate = dmc_rates[d.rate];
+        return std::max(d.next_clock, _s.time) - _s.time + (d.bits - 1u) * rate;
+    }
+
+    void restart_dmc() noexcept {
+        _s.dmc.addr = _s.dmc.sample_addr;
+        _s.dmc.remaining = _s.dmc.sample_length;
+    }
+
+    // the memory reader refills the sample buffer as soon as it is empty
+    void fill_dmc() noexcept {
+        auto &d = _s.dmc;
+        if (d.buffer_full || !d.remaining)
+            return;
+
+        d.buffer = _cartridge->fetch_u8(d.addr);
+        d.buffer_full = true;
+        _dma_stall += dmc_stall;
+        d.addr = d.addr == 0xffff ? 0x8000 : d.addr + 1;
+        if (--d.remaining == 0) {
+            if (d.loop)
+                restart_dmc();
+            else if (d.irq_enabled)
+                d.irq = true;
+        }
+    }
+
+    void clock_dmc() noexcept {
+        auto &d = _s.dmc;
+        if (!d.silence) {
+            if (d.shift & 0x01u) {
+                if (d.level <= 125)
+                    d.level += 2;
+            } else if (d.level >= 2) {
+                d.level -= 2;
+            }
+        }
+        d.shift >>= 1u;
+
+        if (--d.bits == 0) {
+            d.bits = 8;
+            d.silence = !d.buffer_full;
+            if (d.buffer_full) {
+                d.shift = d.buffer;
+                d.buffer_full = false;
+                fill_dmc();
+            }
+        }
+    }
+
+    void clock_tones() noexcept {
+        auto time = _s.time;
+        for (auto [p, ones_complement] : {std::pair{&_s.pulse1, true}, std::pair{&_s.pulse2, false}}) {
+            if (p->next_clock == time && pulse_active(*p, ones_complement)) {
+                p->step = (p->step + 1) & 0x07u;
+                p->next_clock += (p->period + 1u) * 2u;
+            }
+        }
+
+        auto &t = _s.triangle;
+        if (t.next_clock == time && triangle_active()) {
+            t.step = (t.step + 1) & 0x1fu;
+            t.next_clock += t.period + 1u;
+        }
+
+        auto &n = _s.noise;
+        if (n.next_clock == time && n.length) {
+            uint16_t feedback = (n.shift ^ (n.shift >> (n.mode ? 6u : 1u))) & 0x01u;
+            n.shift = (n.shift >> 1u) | (feedback << 14u);
+            n.next_clock += noise_periods[n.period];
+        }
+    }
+
+    [[nodiscard]] float mix() const noexcept {
+        auto pulse = [](state::pulse_channel const &p, bool ones_complement) -> unsigned {
+            if (!p.length || muted(p, ones_complement) || !duty_table[p.duty][p.step])
+                return 0;
+            return volume(p.env);
+        };
+        unsigned triangle = triangle_table[_s.triangle.step];
+        unsigned noise = (_s.noise.shift & 0x01u) || !_s.noise.length ? 0 : volume(_s.noise.env);
+        return pulse_table[pulse(_s.pulse1, true) + pulse(_s.pulse2, false)] +
+               tnd_table[3 * triangle + 2 * noise + _s.dmc.level];
+    }
+
+    void update_output() noexcept {
+        if (!_output)
+            return;
+        auto amplitude = mix();
+        if (amplitude != _amplitude) {
+            _blip.add_delta(_s.time - _blip_start, amplitude - _amplitude);
+            _amplitude = amplitude;
+        }
+    }
+
+    void flush() {
+        _blip.end_frame(_s.time - _blip_start, _samples);
+        _blip_start = _s.time;
+        if (_samples.size() > max_samples)
+            _samples.erase(_samples.begin(), _samples.end() - max_samples);
+    }
+
+    // walk from one timer edge or sequencer step to the next up to target
+    void run_until(uint64_t target) {
+        while (_s.time < target) {
+            auto stop = std::min(target, frame_event());
+            stop = std::min(stop, next(_s.dmc.next_clock, dmc_active()));
+            if (_output) {
+                stop = std::min(stop, _blip_start + _blip.max_clocks());
+                stop = std::min(stop, next(_s.pulse1.next_clock, pulse_active(_s.pulse1, true)));
+                stop = std::min(stop, next(_s.pulse2.next_clock, pulse_active(_s.pulse2, false)));
+                stop = std::min(stop, next(_s.triangle.next_clock, triangle_active()));
+                stop = std::min(stop, next(_s.noise.next_clock, _s.noise.length != 0));
+            }
+            _s.time = stop;
+
+            if (_s.time == frame_event())
+                clock_frame_sequencer();
+            if (_s.time == _s.dmc.next_clock && dmc_active()) {
+                clock_dmc();
+                _s.dmc.next_clock += dmc_rates[_s.dmc.rate];
+            }
+            if (_output) {
+                clock_tones();
+                update_output();
+                if (_s.time - _blip_start >= _blip.max_clocks())
+                    flush();
+            }
+        }
+    }
+
+    void store(uint16_t addr, uint8_t data) noexcept {
+        switch (addr & 0x1fu) {
+            case 0x00:
+            case 0x01:
+            case 0x02:
+            case 0x03:
+                store_pulse(_s.pulse1, addr & 0x03u, data);
+                break;
+            case 0x04:
+            case 0x05:
+            case 0x06:
+            case 0x07:
+                store_pulse(_s.pulse2, addr & 0x03u, data);
+                break;
+            case 0x08:
+                _s.triangle.control = data & 0x80u;
+                _s.triangle.linear_period = data & 0x7fu;
+                break;
+            case 0x0a:
+                _s.triangle.period = (_s.triangle.period & 0x0700u) | data;
+                break;
+            case 0x0b:
+                _s.triangle.period = (_s.triangle.period & 0x00ffu) | ((data & 0x07u) << 8u);
+                if (_s.triangle.enabled)
+                    _s.triangle.length = length_table[data >> 3u];
+                _s.triangle.linear_reload = true;
+                break;
+            case 0x0c:
+                store_envelope(_s.noise.env, data);
+                break;
+            case 0x0e:
+                _s.noise.mode = data & 0x80u;
+                _s.noise.period = data & 0x0fu;
+                break;
+            case 0x0f:
+                if (_s.noise.enabled)
+                    _s.noise.length = length_table[data >> 3u];
+                _s.noise.env.start = true;
+                break;
+            case 0x10:
+                _s.dmc.irq_enabled = data & 0x80u;
+                _s.dmc.loop = data & 0x40u;
+                _s.dmc.rate = data & 0x0fu;
+                if (!_s.dmc.irq_enabled)
+                    _s.dmc.irq = false;
+                break;
+            case 0x11:
+                _s.dmc.level = data & 0x7fu;
+                break;
+            case 0x12:
+                _s.dmc.sample_addr = static_cast<uint16_t>(0xc000u | (data << 6u));
+                break;
+            case 0x13:
+                _s.dmc.sample_length = static_cast<uint16_t>((data << 4u) | 0x01u);
+                break;
+            case 0x15:
+                store_status(data);
+                break;
+            case 0x17:
+                _s.five_step = data & 0x80u;
+                _s.irq_inhibit = data & 0x40u;
+                if (_s.irq_inhibit)
+                    _s.frame_irq = false;
+                _s.frame_start = _s.time;
+                _s.frame_step = 0;
+                if (_s.five_step) {
+                    quarter_frame();
+                    half_frame();
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void store_status(uint8_t data) noexcept {
+        auto enable = [](bool &enabled, uint8_t &length, bool value) {
+            enabled = value;
+            if (!enabled)
+                length = 0;
+        };
+        enable(_s.pulse1.enabled, _s.pulse1.length, data & 0x01u);
+        enable(_s.pulse2.enabled, _s.pulse2.length, data & 0x02u);
+        enable(_s.triangle.enabled, _s.triangle.length, data & 0x04u);
+        enable(_s.noise.enabled, _s.noise.length, data & 0x08u);
+
+        _s.dmc.irq = false;
+        if (!(data & 0x10u)) {
+            _s.dmc.remaining = 0;
+        } else if (!_s.dmc.remaining) {
+            restart_dmc();
+            fill_dmc();
+        }
+    }
+
+    uint8_t fetch_status() noexcept {
+        uint8_t status = (_s.pulse1.length ? 0x01u : 0x00u) | (_s.pulse2.length ? 0x02u : 0x00u) |
+                         (_s.triangle.length ? 0x04u : 0x00u) | (_s.noise.length ? 0x08u : 0x00u) |
+                         (_s.dmc.remaining ? 0x10u : 0x00u) | (_s.frame_irq ? 0x40u : 0x00u) |
+                         (_s.dmc.irq ? 0x80u : 0x00u);
+        _s.frame_irq = false;
+        return status;
+    }
+
+    // the synthesizer starts over from the current amplitude
+    void restart_output() noexcept {
+        _blip.clear();
+        _blip_start = _s.time;
+        _amplitude = 0;
+        update_output();
+    }
+
+    friend apu;
+};
+
+apu::apu(cartridge::cartridge &cartridge) : _impl(std::make_unique<apu_impl>()) {
+    _impl->_cartridge = &cartridge;
+    _impl->_samples.reserve(max_samples);
+}
+
+apu::~apu() = default;
+
+void apu::catch_up() {
+    _impl->run_until(_impl->_s.time + _pending);
+    _pending = 0;
+}
+
+void apu::reset() {
+    catch_up();
+    auto &impl = *_impl;
+    impl.store(0x4015, 0x00);
+    impl._s.dmc.level = 0;
+    impl._s.frame_irq = false;
+    impl._s.frame_start = impl._s.time;
+    impl._s.frame_step = 0;
+    impl.update_output();
+}
+
+uint8_t apu::fetch_register(uint16_t addr) {
+    if (addr != 0x4015)
+        return 0;
+    catch_up();
+    return _impl->fetch_status();
+}
+
+void apu::store_register(uint16_t addr, uint8_t data) {
+    catch_up();
+    _impl->store(addr, data);
+    _impl->update_output();
+}
+
+bool apu::irq() {
+    catch_up();
+    return _impl->_s.frame_irq || _impl->_s.dmc.irq;
+}
+
+uint64_t apu::cycles_to_irq() {
+    catch_up();
+    return _impl->cycles_to_irq();
+}
+
+uint64_t apu::cycles_to_dma() {
+    catch_up();
+    return _impl->cycles_to_dma();
+}
+
+uint64_t apu::take_dma_stall() {
+    catch_up();
+    return std::exchange(_impl->_dma_stall, 0);
+}
+
+void apu::enable_output(bool enabled) {
+    catch_up();
+    _impl->_output = enabled;
+    _impl->_samples.clear();
+    _impl->restart_output();
+}
+
+bool apu::output_enabled() const noexcept {
+    return _impl->_output;
+}
+
+std::size_t apu::read_samples(std::span<int16_t> out) {
+    catch_up();
+    auto &impl = *_impl;
+    if (impl._output)
+        impl.flush();
+
+    auto count = std::min(out.size(), impl._samples.size());
+    std::copy_n(impl._samples.begin(), count, out.begin());
+    impl._samples.erase(impl._samples.begin(), impl._samples.begin() + static_cast<std::ptrdiff_t>(count));
+    return count;
+}
+
+void apu::save(apu_state &state) {
+    catch_up();
+    state = _impl->_s;
+}
+
+void apu::load(apu_state const &state) {
+    _pending = 0;
+    _impl->_s = state;
+    _impl->_dma_stall = 0;
+    _impl->_samples.clear();
+    _impl->restart_output();
+}
@@ -0,0 +1,67 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "apu/blip_buffer.h"
+
+using namespace nes::apu;
+
+namespace {
+    // cutoff of the impulse, relative to the nyquist frequency of the output
+    constexpr double cutoff{0.9};
+    constexpr float highpass{0.996f};
+    constexpr float volume{28000.f};
+}
+
+blip_buffer::blip_buffer(double clock_rate, double sample_rate, std::size_t capacity) : _factor(
+        sample_rate / clock_rate), _capacity(capacity), _deltas(capacity + taps) {
+    for (int phase = 0; phase < phases; phase++) {
+        auto &kernel = _kernels[phase];
+        double sum = 0;
+        for (int i = 0; i < taps; i++) {
+            // distance from the step to the sample, the step sits between taps / 2 - 1 and taps / 2
+            double x = (i - taps / 2 + 1) - static_cast<double>(phase) / phases;
+            double sinc = x == 0 ? 1.0 : std::sin(std::numbers::pi * cutoff * x) / (std::numbers::pi * cutoff * x);
+            double w = (x + taps / 2.0) / taps;
+            double blackman = 0.42 - 0.5 * std::cos(2 * std::numbers::pi * w) + 0.08 * std::cos(4 * std::numbers::pi * w);
+            kernel[i] = static_cast<float>(sinc * blackman);
+            sum += kernel[i];
+        }
+        for (auto &k : kernel)
+            k = static_cast<float>(k / sum);
+    }
+}
+
+uint64_t blip_buffer::max_clocks() const noexcept {
+    return static_cast<uint64_t>(static_cast<double>(_capacity - 1) / _factor);
+}
+
+void blip_buffer::end_frame(uint64_t clocks, std::vector<int16_t> &out) {
+    auto end = _offset + static_cast<double>(clocks) * _factor;
+    auto count = static_cast<std::size_t>(end);
+
+    for (std::size_t i = 0; i < count; i++) {
+        _sum += _deltas[i];
+        _last_out = _sum - _last_in + highpass * _last_out;
+        _last_in = _sum;
+        out.push_back(static_cast<int16_t>(std::clamp(_last_out * volume, -32768.f, 32767.f)));
+    }
+
+    // the tails of the last impulses belong to the next frame
+    std::copy(_deltas.begin() + static_cast<std::ptrdiff_t>(count),
+              _deltas.begin() + static_cast<std::ptrdiff_t>(count + taps), _deltas.begin());
+    std::fill(_deltas.begin() + taps, _deltas.end(), 0.f);
+    _offset = end - static_cast<double>(count);
+}
+
+void blip_buffer::clear() noexcept {
+    std::fill(_deltas.begin(), _deltas.end(), 0.f);
+    _offset = 0;
+    _sum = 0;
+    _last_in = 0;
+    _last_out = 0;
+}
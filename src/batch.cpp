@@ -0,0 +1,112 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+#include "core/batch.h"
+
+static void usage(char const *name) {
+    fmt::print(stderr, "usage: {} [--frames N] [--threads N] [--hash-every N] [--movie file.fm2] [--jit] <rom | @list>...\n", name);
+}
+
+// a rom path and an optional movie, the movie of the command line when none is given
+struct entry {
+    std::filesystem::path rom;
+    std::filesystem::path movie;
+};
+
+// one rom path per line, optionally followed by a tab and a movie path,
+// empty lines and lines starting with # are skipped
+static bool read_list(std::filesystem::path const &path, std::vector<entry> &roms) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    for (std::string line; std::getline(in, line);) {
+        if (line.empty() || line.front() == '#')
+            continue;
+        auto tab = line.find('\t');
+        if (tab == std::string::npos)
+            roms.push_back({line, {}});
+        else
+            roms.push_back({line.substr(0, tab), line.substr(tab + 1)});
+    }
+    return true;
+}
+
+int main(int ac, char **av) {
+    uint64_t frames{600};
+    uint64_t hash_every{0};
+    std::size_t threads{0};
+    bool jit{false};
+    std::filesystem::path movie;
+    std::vector<entry> roms;
+
+    for (int i = 1; i < ac; i++) {
+        std::string_view arg{av[i]};
+        if (arg == "--frames" && i + 1 < ac) {
+            frames = std::strtoull(av[++i], nullptr, 10);
+        } else if (arg == "--threads" && i + 1 < ac) {
+            threads = std::strtoull(av[++i], nullptr, 10);
+        } else if (arg == "--hash-every" && i + 1 < ac) {
+            hash_every = std::strtoull(av[++i], nullptr, 10);
+        } else if (arg == "--movie" && i + 1 < ac) {
+            movie = av[++i];
+        } else if (arg == "--jit") {
+            jit = true;
+        } else if (arg.starts_with("@")) {
+            if (!read_list(std::filesystem::path(arg.substr(1)), roms)) {
+                spdlog::error("cannot read rom list {}", arg.substr(1));
+                return EXIT_FAILURE;
+            }
+        } else if (arg.starts_with("--")) {
+            usage(av[0]);
+            return EXIT_FAILURE;
+        } else {
+            roms.push_back({arg, {}});
+        }
+    }
+    if (roms.empty()) {
+        usage(av[0]);
+        return EXIT_FAILURE;
+    }
+
+    // one line per cartridge would drown the results
+    spdlog::set_level(spdlog::level::warn);
+
+    std::vector<nes::core::batch_job> jobs;
+    jobs.reserve(roms.size());
+    for (auto const &[rom, rom_movie] : roms)
+        jobs.push_back({rom, frames, jit, hash_every, rom_movie.empty() ? movie : rom_movie});
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = nes::core::run_batch(jobs, threads);
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+
+    uint64_t total_frames{0};
+    std::size_t failed{0};
+    for (auto const &result : results) {
+        if (!result.error.empty()) {
+            fmt::print("{} error {}\n", result.job.rom.string(), result.error);
+            failed++;
+            continue;
+        }
+        total_frames += result.frames;
+        fmt::print("{} frames {} last {:016x} chain {:016x} wall {:.3f} s {:.1f} fps\n", result.job.rom.string(),
+                   result.frames, result.last_hash, result.chain_hash, result.seconds,
+                   static_cast<double>(result.frames) / result.seconds);
+        for (auto const &[frame, hash] : result.hashes)
+            fmt::print("  frame {} {:016x}\n", frame, hash);
+    }
+
+    fmt::print("{} jobs, {} failed, {:.3f} s, {:.1f} frames/s overall\n", results.size(), failed, total.count(),
+               static_cast<double>(total_frames) / total.count());
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
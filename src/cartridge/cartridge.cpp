@@ -1,124 +1,157 @@
-#include <fstream>
-#include <streambuf>
+#include <algorithm>
+#include <bit>
 #include <vector>
 
 #include <spdlog/spdlog.h>
 
 #include "cartridge/cartridge.h"
-#include "memory/block.h"
 
 using namespace nes::cartridge;
 
 struct nes::cartridge::cartridge_impl {
 private:
-    std::filesystem::path _path;
-    bool _mirroring{false};
-    bool _battery{false};
-    bool _trainer{false};
-    bool _ignore_mirr{false};
-    mapper_type _mapper{mapper_type::mapper_0};
+    std::shared_ptr<rom const> _rom;
+    std::unique_ptr<mapper> _mapper;
 
-    std::unique_ptr<memory::block> _prg_rom;
-    std::unique_ptr<memory::block> _prg_ram;
-    std::unique_ptr<memory::block> _chr_ram;
+    // mirrored over $6000-$7fff, empty when the board has none
+    std::vector<uint8_t> _prg_ram;
+    // empty when the board has chr-rom
+    std::vector<uint8_t> _chr_ram;
 
     friend cartridge;
 };
 
-cartridge::cartridge(std::filesystem::path path) : _impl(std::make_unique<cartridge_impl>()) {
-    _impl->_path = std::move(path);
-
-    std::ifstream file(_impl->_path.string(), std::ios::binary);
-    file.unsetf(std::ios::skipws);
-
-    std::vector<uint8_t> data;
-    spdlog::info("{:#06x}", std::filesystem::file_size(_impl->_path));
-
-    data.reserve(std::filesystem::file_size(_impl->_path));
-    std::copy(std::istream_iterator<uint8_t>(file), std::istream_iterator<uint8_t>(), std::back_insert_iterator(data));
-
-    struct {
-        uint8_t magic[4];
-        uint8_t nb_prog_rom;
-        uint8_t nb_chr_rom;
-        uint8_t flag6;
-    } *header{reinterpret_cast<decltype(header)>(&data[0])};
-
-    if (header->flag6 & 0x01) _impl->_mirroring = true;
-    if (header->flag6 & 0x02) _impl->_battery = true;
-    if (header->flag6 & 0x04) _impl->_trainer = true;
-    if (header->flag6 & 0x08) _impl->_ignore_mirr = true;
-
-    if ((header->flag6 >> 4) != 0) {
-        spdlog::error("invalid mapper"); //TBD throw...
-        exit(EXIT_FAILURE);
-    }
-
-    std::vector<uint8_t> romMemory;
-    auto offset = 16;
-    romMemory.insert(romMemory.end(), data.begin() + offset,
-                     data.begin() + offset + (header->nb_prog_rom * 16384));
-    _impl->_prg_rom = std::make_unique<memory::block>(std::move(romMemory));
+cartridge::cartridge(std::filesystem::path path) : cartridge(std::make_shared<rom const>(std::move(path))) {
+}
 
-    std::vector<uint8_t> chrMemory;
-    offset += header->nb_prog_rom * 16384;
-    chrMemory.insert(chrMemory.end(), std::make_move_iterator(data.begin() + offset),
-                     std::make_move_iterator(data.begin() + offset + (header->nb_prog_rom * 8192)));
-    _impl->_chr_ram = std::make_unique<memory::block>(std::move(chrMemory));
+cartridge::cartridge(std::shared_ptr<rom const> rom) : _impl(std::make_unique<cartridge_impl>()) {
+    _impl->_rom = std::move(rom);
+    auto const &header = _impl->_rom->header();
+
+    // prg-ram is sized from the header, rounded to whole pages and mirrored. Only the first 8k are mapped,
+    // no board here banks prg-ram. A trainer is loaded at $7000 and needs the whole window.
+    auto prg_ram = header.prg_ram_size + header.prg_nvram_size;
+    if (header.trainer)
+        prg_ram = 0x2000;
+    if (prg_ram)
+        _impl->_prg_ram.resize(std::bit_ceil(std::clamp<std::size_t>(prg_ram, 0x100, 0x2000)));
+    auto trainer = _impl->_rom->trainer();
+    if (!trainer.empty())
+        std::copy(trainer.begin(), trainer.end(), _impl->_prg_ram.begin() + (0x7000 - 0x6000));
+    if (header.chr_rom_size == 0)
+        _impl->_chr_ram.resize(std::clamp<std::size_t>(header.chr_ram_size + header.chr_nvram_size, 0x2000, 0x8000));
+    _impl->_mapper = make_mapper(_impl->_rom, _impl->_chr_ram);
+
+    spdlog::info("{}: mapper {}.{} prg {:#x} chr {:#x}", file().string(), header.mapper, header.submapper,
+                 header.prg_rom_size, header.chr_rom_size ? header.chr_rom_size : _impl->_chr_ram.size());
 }
 
 cartridge::~cartridge() = default;
 
 std::filesystem::path cartridge::file() const noexcept {
-    return _impl->_path;
+    return _impl->_rom->file();
+}
+
+std::shared_ptr<rom const> const &cartridge::image() const noexcept {
+    return _impl->_rom;
+}
+
+rom_header const &cartridge::header() const noexcept {
+    return _impl->_rom->header();
 }
 
 bool cartridge::mirroring() const noexcept {
-    return _impl->_mirroring;
+    return header().vertical_mirroring;
 }
 
 bool cartridge::battery_packed_ram() const noexcept {
-    return _impl->_battery;
+    return header().battery;
 }
 
 bool cartridge::trainer() const noexcept {
-    return _impl->_trainer;
+    return header().trainer;
 }
 
 bool cartridge::ignore_mirroring() const noexcept {
-    return _impl->_mirroring;
+    return header().four_screen;
 }
 
 mapper_type cartridge::mapper() const noexcept {
-    return mapper_type::mapper_0;
+    return _impl->_mapper->type();
+}
+
+mapper &cartridge::board() const noexcept {
+    return *_impl->_mapper;
+}
+
+mirroring_mode cartridge::nametable_mirroring() const noexcept {
+    return _impl->_mapper->mirroring();
+}
+
+uint8_t const *cartridge::prg_page(std::uint8_t page) const noexcept {
+    if (page >= 0x80)
+        return _impl->_mapper->prg_page(page);
+    else if (page >= 0x60)
+        return prg_ram_page(page);
+    else
+        return nullptr;
+}
+
+uint8_t *cartridge::prg_ram_page(std::uint8_t page) const noexcept {
+    auto &prg_ram = _impl->_prg_ram;
+    if (page >= 0x60 && page < 0x80 && !prg_ram.empty())
+        return prg_ram.data() + (((page - 0x60) << 8u) & (prg_ram.size() - 1));
+    else
+        return nullptr;
+}
+
+std::span<uint8_t const> cartridge::chr() const noexcept {
+    if (!_impl->_chr_ram.empty())
+        return _impl->_chr_ram;
+    return _impl->_rom->chr();
 }
 
 uint8_t cartridge::fetch_u8(std::uint16_t addr) const {
-    if (addr < 0x2000)
-        return _impl->_prg_ram->fetch_u8(addr);
-    else if (addr < 0x6000)
-        return _impl->_prg_rom->fetch_u8(addr - 0x2000);
+    if (addr >= 0x8000)
+        return _impl->_mapper->prg_page(addr >> 8u)[addr & 0xffu];
+    else if (addr >= 0x6000 && !_impl->_prg_ram.empty())
+        return _impl->_prg_ram[(addr - 0x6000) & (_impl->_prg_ram.size() - 1)];
     else
-        return _impl->_prg_rom->fetch_u8(addr - 0x6000);
+        return 0;
 }
 
 uint16_t cartridge::fetch_u16(std::uint16_t addr) const {
-    if (addr < 0x2000)
-        return _impl->_prg_ram->fetch_u16(addr);
-    else if (addr < 0x6000)
-        return _impl->_prg_rom->fetch_u16(addr - 0x2000);
-    else
-        return _impl->_prg_rom->fetch_u16(addr - 0x6000);
+    return fetch_u8(addr) | (fetch_u8(addr + 1) << 8u);
 }
 
 void cartridge::store(std::uint16_t addr, std::uint8_t data) {
-
+    if (addr >= 0x8000)
+        _impl->_mapper->store(addr, data);
+    else if (addr >= 0x6000 && !_impl->_prg_ram.empty())
+        _impl->_prg_ram[(addr - 0x6000) & (_impl->_prg_ram.size() - 1)] = data;
 }
 
 void cartridge::store(std::uint16_t addr, std::uint16_t data) {
+    store(addr, static_cast<uint8_t>(data & 0xffu));
+    store(static_cast<uint16_t>(addr + 1), static_cast<uint8_t>(data >> 8u));
+}
+
+void cartridge::save(cartridge_state &state) const noexcept {
+    auto const &prg_ram = _impl->_prg_ram;
+    std::copy_n(prg_ram.begin(), std::min(prg_ram.size(), state.prg_ram.size()), state.prg_ram.begin());
+    auto const &chr_ram = _impl->_chr_ram;
+    std::copy_n(chr_ram.begin(), std::min(chr_ram.size(), state.chr_ram.size()), state.chr_ram.begin());
+    _impl->_mapper->save(state.mapper);
+}
 
+void cartridge::load(cartridge_state const &state) noexcept {
+    auto &prg_ram = _impl->_prg_ram;
+    std::copy_n(state.prg_ram.begin(), std::min(prg_ram.size(), state.prg_ram.size()), prg_ram.begin());
+    auto &chr_ram = _impl->_chr_ram;
+    std::copy_n(state.chr_ram.begin(), std::min(chr_ram.size(), state.chr_ram.size()), chr_ram.begin());
+    _impl->_mapper->load(state.mapper);
 }
 
-std::vector<uint8_t> const& cartridge::data() const {
-    return _impl->_prg_rom->data();
+std::span<uint8_t const> cartridge::data() const {
+    return _impl->_rom->prg();
 }
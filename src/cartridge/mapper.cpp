@@ -0,0 +1,104 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <fmt/format.h>
+
+#include "cartridge/mappers.h"
+
+using namespace nes::cartridge;
+
+mapper::mapper(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram) : _rom(std::move(rom)) {
+    _prg_rom = _rom->prg();
+    if (chr_ram.empty()) {
+        _chr_mem = _rom->chr();
+    } else {
+        _chr_mem = chr_ram;
+        _chr_ram = chr_ram;
+    }
+
+    auto const &header = _rom->header();
+    if (header.four_screen)
+        _mirroring = mirroring_mode::four_screen;
+    else if (header.vertical_mirroring)
+        _mirroring = mirroring_mode::vertical;
+
+    map_prg_32k(0);
+    map_chr_8k(0);
+}
+
+void mapper::save(mapper_state &state) const noexcept {
+    state.type = type();
+    state.mirroring = _mirroring;
+}
+
+void mapper::load(mapper_state const &state) noexcept {
+    _mirroring = state.mirroring;
+}
+
+void mapper::map_prg_8k(uint8_t slot, int bank) noexcept {
+    auto count = prg_banks_8k();
+    bank = ((bank % count) + count) % count;
+    _prg[slot & 0x03u] = _prg_rom.data() + bank * 0x2000;
+}
+
+void mapper::map_prg_16k(uint8_t slot, int bank) noexcept {
+    auto count = prg_banks_8k() / 2;
+    bank = ((bank % count) + count) % count;
+    map_prg_8k(slot * 2, bank * 2);
+    map_prg_8k(slot * 2 + 1, bank * 2 + 1);
+}
+
+void mapper::map_prg_32k(int bank) noexcept {
+    // a 16k rom is mirrored in both halves
+    if (prg_banks_8k() < 4) {
+        map_prg_16k(0, 0);
+        map_prg_16k(1, 0);
+        return;
+    }
+    map_prg_16k(0, bank * 2);
+    map_prg_16k(1, bank * 2 + 1);
+}
+
+void mapper::map_chr_1k(uint8_t slot, int bank) noexcept {
+    auto count = static_cast<int>(_chr_mem.size() / 0x400);
+    bank = ((bank % count) + count) % count;
+    _chr[slot & 0x07u] = _chr_mem.data() + bank * 0x400;
+    _chr_offsets[slot & 0x07u] = static_cast<std::size_t>(bank) * 0x400;
+}
+
+void mapper::map_chr_4k(uint8_t slot, int bank) noexcept {
+    for (uint8_t i = 0; i < 4; i++)
+        map_chr_1k(slot * 4 + i, bank * 4 + i);
+}
+
+void mapper::map_chr_8k(int bank) noexcept {
+    for (uint8_t i = 0; i < 8; i++)
+        map_chr_1k(i, bank * 8 + i);
+}
+
+std::unique_ptr<mapper> nes::cartridge::make_mapper(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram) {
+    auto number = rom->header().mapper;
+    if (rom->prg().size() < 0x4000 || rom->prg().size() % 0x2000)
+        throw rom_error(fmt::format("invalid prg size {:#x}", rom->prg().size()));
+    if (rom->chr().empty() && chr_ram.empty())
+        throw rom_error("no chr memory");
+    // chr is banked by 1k, a chr-rom smaller than that would leave no bank to map
+    if (!rom->chr().empty() && rom->chr().size() % 0x400)
+        throw rom_error(fmt::format("invalid chr size {:#x}", rom->chr().size()));
+
+    switch (number) {
+        case 0:
+            return std::make_unique<nrom>(std::move(rom), chr_ram);
+        case 1:
+            return std::make_unique<mmc1>(std::move(rom), chr_ram);
+        case 2:
+            return std::make_unique<uxrom>(std::move(rom), chr_ram);
+        case 3:
+            return std::make_unique<cnrom>(std::move(rom), chr_ram);
+        case 4:
+            return std::make_unique<mmc3>(std::move(rom), chr_ram);
+        default:
+            throw rom_error(fmt::format("unsupported mapper {}", number));
+    }
+}
@@ -0,0 +1,26 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include "cartridge/mappers.h"
+
+using namespace nes::cartridge;
+
+cnrom::cnrom(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram) : mapper(std::move(rom), chr_ram) {
+}
+
+void cnrom::store(uint16_t, uint8_t data) {
+    _bank = data;
+    map_chr_8k(_bank);
+}
+
+void cnrom::save(mapper_state &state) const noexcept {
+    mapper::save(state);
+    state.regs[0] = _bank;
+}
+
+void cnrom::load(mapper_state const &state) noexcept {
+    mapper::load(state);
+    _bank = state.regs[0];
+    map_chr_8k(_bank);
+}
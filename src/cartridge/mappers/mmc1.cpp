@@ -0,0 +1,102 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include "cartridge/mappers.h"
+
+using namespace nes::cartridge;
+
+mmc1::mmc1(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram) : mapper(std::move(rom), chr_ram) {
+    update_banks();
+}
+
+void mmc1::store(uint16_t addr, uint8_t data) {
+    if (data & 0x80u) {
+        _shift = 0x10;
+        _control |= 0x0cu;
+        update_banks();
+        return;
+    }
+
+    // the fifth write (when the marker bit reaches bit 0) commits the register selected by addr
+    bool full = _shift & 0x01u;
+    _shift = (_shift >> 1u) | ((data & 0x01u) << 4u);
+    if (!full)
+        return;
+
+    switch ((addr >> 13u) & 0x03u) {
+        case 0:
+            _control = _shift;
+            break;
+        case 1:
+            _chr0 = _shift;
+            break;
+        case 2:
+            _chr1 = _shift;
+            break;
+        case 3:
+            _prg = _shift;
+            break;
+    }
+    _shift = 0x10;
+    update_banks();
+}
+
+void mmc1::save(mapper_state &state) const noexcept {
+    mapper::save(state);
+    state.regs = {_shift, _control, _chr0, _chr1, _prg};
+}
+
+void mmc1::load(mapper_state const &state) noexcept {
+    mapper::load(state);
+    _shift = state.regs[0];
+    _control = state.regs[1];
+    _chr0 = state.regs[2];
+    _chr1 = state.regs[3];
+    _prg = state.regs[4];
+    update_banks();
+}
+
+void mmc1::update_banks() noexcept {
+    switch (_control & 0x03u) {
+        case 0:
+            _mirroring = mirroring_mode::single_screen_lo;
+            break;
+        case 1:
+            _mirroring = mirroring_mode::single_screen_hi;
+            break;
+        case 2:
+            _mirroring = mirroring_mode::vertical;
+            break;
+        case 3:
+            _mirroring = mirroring_mode::horizontal;
+            break;
+    }
+
+    // 512k boards (SUROM) select the 256k prg half with chr0 bit 4
+    int outer = prg_banks_8k() > 32 ? (_chr0 & 0x10u) : 0;
+    int bank = outer | (_prg & 0x0fu);
+    switch ((_control >> 2u) & 0x03u) {
+        case 0:
+        case 1:
+            map_prg_16k(0, bank & ~1);
+            map_prg_16k(1, bank | 1);
+            break;
+        case 2:
+            map_prg_16k(0, outer);
+            map_prg_16k(1, bank);
+            break;
+        case 3:
+            map_prg_16k(0, bank);
+            map_prg_16k(1, outer | 0x0f);
+            break;
+    }
+
+    if (_control & 0x10u) {
+        map_chr_4k(0, _chr0);
+        map_chr_4k(1, _chr1);
+    } else {
+        map_chr_4k(0, _chr0 & ~1);
+        map_chr_4k(1, _chr0 | 1);
+    }
+}
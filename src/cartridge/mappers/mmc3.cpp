@@ -0,0 +1,113 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+
+#include "cartridge/mappers.h"
+
+using namespace nes::cartridge;
+
+mmc3::mmc3(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram) : mapper(std::move(rom), chr_ram) {
+    update_banks();
+}
+
+void mmc3::store(uint16_t addr, uint8_t data) {
+    bool odd = addr & 0x01u;
+
+    switch (addr & 0xe000u) {
+        case 0x8000:
+            if (odd)
+                _banks[_bank_select & 0x07u] = data;
+            else
+                _bank_select = data;
+            update_banks();
+            break;
+        case 0xa000:
+            // odd: prg-ram protect, prg-ram is always enabled
+            if (!odd && _mirroring != mirroring_mode::four_screen)
+                _mirroring = (data & 0x01u) ? mirroring_mode::horizontal : mirroring_mode::vertical;
+            break;
+        case 0xc000:
+            if (odd)
+                _irq_reload = true;
+            else
+                _irq_latch = data;
+            break;
+        case 0xe000:
+            _irq_enabled = odd;
+            if (!odd)
+                _irq_pending = false;
+            break;
+        default:
+            break;
+    }
+}
+
+void mmc3::scanline() noexcept {
+    if (_irq_counter == 0 || _irq_reload) {
+        _irq_counter = _irq_latch;
+        _irq_reload = false;
+    } else {
+        _irq_counter--;
+    }
+
+    if (_irq_counter == 0 && _irq_enabled)
+        _irq_pending = true;
+}
+
+uint32_t mmc3::scanlines_to_irq() const noexcept {
+    if (_irq_pending)
+        return 0;
+    if (!_irq_enabled)
+        return std::numeric_limits<uint32_t>::max();
+    // a zero or reloaded counter takes the latch first
+    if (_irq_counter == 0 || _irq_reload)
+        return _irq_latch + 1u;
+    return _irq_counter;
+}
+
+void mmc3::save(mapper_state &state) const noexcept {
+    mapper::save(state);
+    state.regs[0] = _bank_select;
+    std::copy(_banks.begin(), _banks.end(), state.regs.begin() + 1);
+    state.regs[9] = _irq_latch;
+    state.regs[10] = _irq_counter;
+    state.regs[11] = (_irq_reload ? 0x01u : 0x00u) | (_irq_enabled ? 0x02u : 0x00u) | (_irq_pending ? 0x04u : 0x00u);
+}
+
+void mmc3::load(mapper_state const &state) noexcept {
+    mapper::load(state);
+    _bank_select = state.regs[0];
+    std::copy_n(state.regs.begin() + 1, _banks.size(), _banks.begin());
+    _irq_latch = state.regs[9];
+    _irq_counter = state.regs[10];
+    _irq_reload = state.regs[11] & 0x01u;
+    _irq_enabled = state.regs[11] & 0x02u;
+    _irq_pending = state.regs[11] & 0x04u;
+    update_banks();
+}
+
+void mmc3::update_banks() noexcept {
+    // prg mode 1 swaps the $8000 and $c000 slots, the second to last bank is the fixed one
+    if (_bank_select & 0x40u) {
+        map_prg_8k(0, -2);
+        map_prg_8k(2, _banks[6]);
+    } else {
+        map_prg_8k(0, _banks[6]);
+        map_prg_8k(2, -2);
+    }
+    map_prg_8k(1, _banks[7]);
+    map_prg_8k(3, -1);
+
+    // chr inversion swaps the 2k and 1k halves
+    uint8_t base = (_bank_select & 0x80u) ? 4 : 0;
+    map_chr_1k(base + 0, _banks[0] & 0xfe);
+    map_chr_1k(base + 1, _banks[0] | 0x01);
+    map_chr_1k(base + 2, _banks[1] & 0xfe);
+    map_chr_1k(base + 3, _banks[1] | 0x01);
+    map_chr_1k((base ^ 4u) + 0, _banks[2]);
+    map_chr_1k((base ^ 4u) + 1, _banks[3]);
+    map_chr_1k((base ^ 4u) + 2, _banks[4]);
+    map_chr_1k((base ^ 4u) + 3, _banks[5]);
+}
@@ -0,0 +1,13 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include "cartridge/mappers.h"
+
+using namespace nes::cartridge;
+
+nrom::nrom(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram) : mapper(std::move(rom), chr_ram) {
+}
+
+void nrom::store(uint16_t, uint8_t) {
+}
@@ -0,0 +1,28 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include "cartridge/mappers.h"
+
+using namespace nes::cartridge;
+
+uxrom::uxrom(std::shared_ptr<rom const> rom, std::span<uint8_t> chr_ram) : mapper(std::move(rom), chr_ram) {
+    map_prg_16k(0, 0);
+    map_prg_16k(1, -1);
+}
+
+void uxrom::store(uint16_t, uint8_t data) {
+    _bank = data;
+    map_prg_16k(0, _bank);
+}
+
+void uxrom::save(mapper_state &state) const noexcept {
+    mapper::save(state);
+    state.regs[0] = _bank;
+}
+
+void uxrom::load(mapper_state const &state) noexcept {
+    mapper::load(state);
+    _bank = state.regs[0];
+    map_prg_16k(0, _bank);
+}
@@ -0,0 +1,141 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <limits>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <fmt/format.h>
+
+#include "cartridge/rom.h"
+
+using namespace nes::cartridge;
+
+struct nes::cartridge::rom_impl {
+private:
+    std::filesystem::path _path;
+    boost::iostreams::mapped_file_source _file;
+    rom_header _header;
+    std::span<uint8_t const> _trainer;
+    std::span<uint8_t const> _prg;
+    std::span<uint8_t const> _chr;
+
+    friend rom;
+};
+
+namespace {
+    constexpr std::size_t header_size{16};
+    constexpr std::size_t trainer_size{512};
+    // larger than any board ever made, NES 2.0 headers can declare sizes up to 7 * 2^63
+    constexpr std::size_t max_rom_size{64u << 20u};
+
+    // NES 2.0 rom sizes are either a 12 bits count of units or, when the msb nibble is $f, an
+    // exponent-multiplier pair
+    std::size_t nes2_rom_size(uint8_t lsb, uint8_t msb, std::size_t unit) {
+        if (msb == 0x0f) {
+            auto exponent = lsb >> 2u;
+            // anything past max_rom_size is refused, keep the product from overflowing
+            if (exponent >= 32)
+                return std::numeric_limits<std::size_t>::max();
+            return (std::size_t{1} << exponent) * ((lsb & 0x03u) * 2 + 1);
+        }
+        return ((msb << 8u) | lsb) * unit;
+    }
+
+    // NES 2.0 ram sizes are shift counts, 0 means no ram
+    std::size_t nes2_ram_size(uint8_t shift) {
+        return shift ? std::size_t{64} << shift : 0;
+    }
+}
+
+rom_header nes::cartridge::parse_header(std::span<uint8_t const> data) {
+    if (data.size() < header_size || data[0] != 'N' || data[1] != 'E' || data[2] != 'S' || data[3] != 0x1a)
+        throw rom_error("not an iNES file");
+
+    rom_header header;
+    auto flag6 = data[6];
+    auto flag7 = data[7];
+
+    header.vertical_mirroring = flag6 & 0x01u;
+    header.battery = flag6 & 0x02u;
+    header.trainer = flag6 & 0x04u;
+    header.four_screen = flag6 & 0x08u;
+    header.nes2 = (flag7 & 0x0cu) == 0x08u;
+
+    if (header.nes2) {
+        header.mapper = (flag6 >> 4u) | (flag7 & 0xf0u) | ((data[8] & 0x0fu) << 8u);
+        header.submapper = data[8] >> 4u;
+        header.console_type = flag7 & 0x03u;
+        header.timing = data[12] & 0x03u;
+        header.prg_rom_size = nes2_rom_size(data[4], data[9] & 0x0fu, 0x4000);
+        header.chr_rom_size = nes2_rom_size(data[5], data[9] >> 4u, 0x2000);
+        header.prg_ram_size = nes2_ram_size(data[10] & 0x0fu);
+        header.prg_nvram_size = nes2_ram_size(data[10] >> 4u);
+        header.chr_ram_size = nes2_ram_size(data[11] & 0x0fu);
+        header.chr_nvram_size = nes2_ram_size(data[11] >> 4u);
+    } else {
+        // old dumps have garbage ("DiskDude!") in bytes 7-15, ignore flag7 for them
+        bool dirty = data[12] || data[13] || data[14] || data[15];
+        header.mapper = (flag6 >> 4u) | (dirty ? 0 : flag7 & 0xf0u);
+        header.prg_rom_size = data[4] * std::size_t{0x4000};
+        header.chr_rom_size = data[5] * std::size_t{0x2000};
+        header.prg_ram_size = (dirty || data[8] == 0) ? 0x2000 : data[8] * std::size_t{0x2000};
+        header.chr_ram_size = header.chr_rom_size ? 0 : 0x2000;
+    }
+
+    if (header.prg_rom_size > max_rom_size || header.chr_rom_size > max_rom_size)
+        throw rom_error(fmt::format("unsupported rom size, prg {:#x} chr {:#x}", header.prg_rom_size,
+                                    header.chr_rom_size));
+
+    return header;
+}
+
+rom::rom(std::filesystem::path path) : _impl(std::make_unique<rom_impl>()) {
+    _impl->_path = std::move(path);
+
+    try {
+        _impl->_file.open(_impl->_path.string());
+    } catch (std::exception const &e) {
+        throw rom_error(fmt::format("cannot map {}: {}", _impl->_path.string(), e.what()));
+    }
+
+    std::span<uint8_t const> data{reinterpret_cast<uint8_t const *>(_impl->_file.data()), _impl->_file.size()};
+    _impl->_header = parse_header(data);
+
+    auto const &header = _impl->_header;
+    auto offset = header_size;
+    auto trainer = header.trainer ? trainer_size : 0;
+    // each part against what is left of the file, a sum of the sizes could wrap
+    auto take = [&](std::size_t size) {
+        if (size > data.size() - offset)
+            throw rom_error(fmt::format("{} is truncated", _impl->_path.string()));
+        auto part = data.subspan(offset, size);
+        offset += size;
+        return part;
+    };
+    _impl->_trainer = take(trainer);
+    _impl->_prg = take(header.prg_rom_size);
+    _impl->_chr = take(header.chr_rom_size);
+}
+
+rom::~rom() = default;
+
+std::filesystem::path const &rom::file() const noexcept {
+    return _impl->_path;
+}
+
+rom_header const &rom::header() const noexcept {
+    return _impl->_header;
+}
+
+std::span<uint8_t const> rom::trainer() const noexcept {
+    return _impl->_trainer;
+}
+
+std::span<uint8_t const> rom::prg() const noexcept {
+    return _impl->_prg;
+}
+
+std::span<uint8_t const> rom::chr() const noexcept {
+    return _impl->_chr;
+}
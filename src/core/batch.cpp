@@ -0,0 +1,105 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+#include "core/batch.h"
+#include "core/console.h"
+#include "core/thread_pool.h"
+#include "input/movie.h"
+
+using namespace nes::core;
+
+namespace {
+    constexpr uint64_t hash_multiplier{0x9fb21c651e98df25ull};
+
+    uint64_t mix(uint64_t h, uint64_t value) noexcept {
+        return std::rotl(h ^ value, 31) * hash_multiplier;
+    }
+
+    void run_job(std::shared_ptr<nes::cartridge::rom const> rom, batch_result &result) {
+        using clock = std::chrono::steady_clock;
+        auto const &job = result.job;
+
+        auto movie = job.movie.empty() ? nes::input::movie() : nes::input::movie(job.movie);
+        auto console = nes::core::console(std::move(rom));
+        auto &cpu = console.cpu();
+        if (job.jit)
+            cpu.enable_jit(true);
+        auto &ppu = console.ppu();
+
+        auto start = clock::now();
+        for (uint64_t frame = 1; frame <= job.frames; frame++) {
+            console.set_input(frame <= movie.size() ? movie[frame - 1] : nes::input::movie_frame{});
+            // the framebuffer is only a whole picture at vblank
+            console.run_frame();
+            auto hash = hash_frame(ppu.framebuffer());
+            result.chain_hash = mix(result.chain_hash, hash);
+            result.last_hash = hash;
+            if (job.hash_every && frame % job.hash_every == 0)
+                result.hashes.emplace_back(frame, hash);
+        }
+        result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+        result.frames = job.frames;
+        result.cycles = cpu.cycles();
+        result.instructions = cpu.instructions();
+    }
+}
+
+uint64_t nes::core::hash_frame(std::span<uint8_t const> pixels) noexcept {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ pixels.size();
+    std::size_t i = 0;
+    for (; i + 8 <= pixels.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, pixels.data() + i, sizeof(word));
+        h = mix(h, word);
+    }
+    for (; i < pixels.size(); i++)
+        h = mix(h, pixels[i]);
+    return h ^ (h >> 29u);
+}
+
+std::vector<batch_result> nes::core::run_batch(std::vector<batch_job> const &jobs, std::size_t threads) {
+    std::vector<batch_result> results(jobs.size());
+
+    // load every rom once, before any job starts, so the jobs only ever read the shared images
+    std::map<std::filesystem::path, std::shared_ptr<cartridge::rom const>> roms;
+    std::map<std::filesystem::path, std::string> errors;
+    for (auto const &job : jobs) {
+        if (roms.contains(job.rom) || errors.contains(job.rom))
+            continue;
+        try {
+            roms.emplace(job.rom, std::make_shared<cartridge::rom const>(job.rom));
+        } catch (std::exception const &e) {
+            errors.emplace(job.rom, e.what());
+        }
+    }
+
+    thread_pool pool(threads);
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+        auto &result = results[i];
+        result.job = jobs[i];
+        if (auto error = errors.find(jobs[i].rom); error != errors.end()) {
+            result.error = error->second;
+            continue;
+        }
+
+        pool.submit([rom = roms.at(jobs[i].rom), &result] {
+            try {
+                run_job(rom, result);
+            } catch (std::exception const &e) {
+                result.error = e.what();
+            }
+        });
+    }
+    pool.wait();
+
+    return results;
+}
@@ -0,0 +1,66 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <fmt/format.h>
+
+#include "core/console.h"
+
+using namespace nes::core;
+
+console::console(std::filesystem::path path) : _cartridge(std::move(path)), _ppu(_cartridge), _apu(_cartridge),
+                                               _scheduler(_cartridge, _ppu, _apu),
+                                               _membus(_cartridge, _ppu, _apu, _controllers, _scheduler),
+                                               _cpu(_membus, _scheduler) {
+}
+
+console::console(std::shared_ptr<cartridge::rom const> rom) : _cartridge(std::move(rom)), _ppu(_cartridge),
+                                                              _apu(_cartridge), _scheduler(_cartridge, _ppu, _apu),
+                                                              _membus(_cartridge, _ppu, _apu, _controllers, _scheduler),
+                                                              _cpu(_membus, _scheduler) {
+}
+
+void console::save(save_state &state) {
+    state.tag = save_state::magic;
+    state.version = save_state::current_version;
+    _scheduler.sync();
+    _cpu.save(state.cpu);
+    _membus.save(state.ram);
+    _cartridge.save(state.cartridge);
+    _ppu.save(state.ppu);
+    _apu.save(state.apu);
+    _controllers.save(state.input);
+}
+
+void console::load(save_state const &state) {
+    if (state.tag != save_state::magic || state.version != save_state::current_version)
+        throw state_error(fmt::format("not a version {} save state", save_state::current_version));
+    if (state.cartridge.mapper.type != _cartridge.mapper())
+        throw state_error(fmt::format("state saved with mapper {}, the cartridge has mapper {}",
+                                      static_cast<int>(state.cartridge.mapper.type),
+                                      static_cast<int>(_cartridge.mapper())));
+
+    // the bus maps the cartridge banks again and the ppu decodes its pattern tables from them
+    _cartridge.load(state.cartridge);
+    _membus.load(state.ram);
+    _ppu.load(state.ppu);
+    _apu.load(state.apu);
+    _controllers.load(state.input);
+    _cpu.load(state.cpu);
+}
+
+uint64_t console::run_frame() {
+    auto start = _cpu.cycles();
+    auto frame = _ppu.frame();
+    // run() catches the ppu up before returning, and the prediction is early rather than late
+    while (_ppu.frame() == frame)
+        _cpu.run((_ppu.dots_to_vblank() + 2) / 3);
+    return _cpu.cycles() - start;
+}
+
+void console::set_input(input::movie_frame const &frame) {
+    if (frame.reset)
+        _cpu.reset();
+    _controllers.set_buttons(0, frame.buttons[0]);
+    _controllers.set_buttons(1, frame.buttons[1]);
+}
@@ -0,0 +1,308 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "core/console.h"
+#include "core/emulator.h"
+#include "core/rewind.h"
+#include "core/spsc_ring.h"
+#include "core/triple_buffer.h"
+#include "cpu/bus_trace.h"
+#include "input/movie.h"
+
+using namespace nes::core;
+
+class nes::core::emulator_impl {
+private:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr auto frame_period = std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(cpu::ntsc_cycles_per_frame) / cpu::ntsc_clock_hz));
+    // how far behind the emulation may fall before it gives up catching up
+    static constexpr int max_late_frames{4};
+
+    console _console;
+    cpu::bus_trace _trace;
+    rewind_buffer _history;
+    std::unique_ptr<save_state> _state{std::make_unique<save_state>()};
+    std::unique_ptr<save_state> _previous{std::make_unique<save_state>()};
+    // recordings start from power-on so that they replay on a fresh console
+    std::unique_ptr<save_state> _power_on{std::make_unique<save_state>()};
+    input::movie _movie;
+    bool _running{false};
+    bool _tracing{false};
+    bool _rewinding{false};
+    bool _recording{false};
+
+    std::thread _thread;
+    std::atomic<bool> _quit{false};
+    std::atomic<bool> _snapshots{true};
+    std::atomic<uint8_t> _buttons{0};
+    spsc_ring<command, 64> _commands;
+    triple_buffer<frame> _frames;
+    triple_buffer<debug_snapshot> _debug;
+    spsc_ring<int16_t, 0x4000> _audio;
+    std::vector<int16_t> _samples = std::vector<int16_t>(0x1000);
+
+    explicit emulator_impl(std::shared_ptr<cartridge::rom const> rom) : _console(std::move(rom)) {
+        _console.apu().enable_output(true);
+        _console.save(*_power_on);
+    }
+
+    void start_recording() {
+        _console.load(*_power_on);
+        _history.clear();
+        _history.push(*_power_on);
+        _movie.clear();
+        _movie.set_rom_name(_console.cartridge().file().filename().string());
+        _recording = true;
+    }
+
+    // the movie is written next to the rom
+    void stop_recording() {
+        if (!_recording)
+            return;
+        _recording = false;
+        auto path = _console.cartridge().file();
+        path.replace_extension(".fm2");
+        try {
+            _movie.save(path);
+            spdlog::info("recorded {} frames to {}", _movie.size(), path.string());
+        } catch (input::movie_error const &e) {
+            spdlog::error("{}", e.what());
+        }
+    }
+
+    // samples that do not fit are dropped, nobody is listening fast enough
+    void publish_audio(bool play) {
+        auto count = _console.apu().read_samples(_samples);
+        if (!play)
+            return;
+        for (std::size_t i = 0; i < count; i++)
+            if (!_audio.push(_samples[i]))
+                break;
+    }
+
+    void publish_frame() {
+        auto &out = _frames.back();
+        auto framebuffer = _console.ppu().framebuffer();
+        std::copy(framebuffer.begin(), framebuffer.end(), out.pixels.begin());
+        out.number = _console.ppu().frame();
+        _frames.publish();
+    }
+
+    void publish_snapshot() {
+        if (!_snapshots.load(std::memory_order_relaxed))
+            return;
+
+        auto &out = _debug.back();
+        auto &membus = _console.membus();
+        auto &cpu = _console.cpu();
+        auto ram = membus.data();
+        out.regs = cpu.registers();
+        out.cycles = cpu.cycles();
+        out.instructions = cpu.instructions();
+        std::copy_n(ram.begin(), std::min(ram.size(), out.ram.size()), out.ram.begin());
+        // peeked, so that the listing neither shows up in a bus trace nor touches io registers
+        auto pc = out.regs.pc;
+        out.listed = 0;
+        for (auto &op : out.listing) {
+            auto peeked = cpu::decoder::peek(pc, membus);
+            if (!peeked)
+                break;
+            op = *peeked;
+            pc += op.bytes;
+            out.listed++;
+        }
+        out.running = _running;
+        out.tracing = _tracing;
+        out.rewinding = _rewinding;
+        out.recording = _recording;
+        out.history = _history.size();
+        _debug.publish();
+    }
+
+    // return true when the machine state changed
+    bool handle_commands() {
+        bool changed{false};
+        command c{};
+        while (_commands.pop(c)) {
+            switch (c) {
+                case command::step:
+                    if (!_running) {
+                        // a single instruction would break the frames of the movie
+                        stop_recording();
+                        _console.cpu().step();
+                        changed = true;
+                    }
+                    break;
+                case command::toggle_running:
+                    _running = !_running;
+                    changed = true;
+                    break;
+                case command::toggle_trace:
+                    _tracing = !_tracing;
+                    _console.membus().set_trace(_tracing ? &_trace : nullptr);
+                    changed = true;
+                    break;
+                case command::save_trace:
+                    _trace.save("bus_trace.bin");
+                    break;
+                case command::rewind_start:
+                case command::rewind_stop:
+                    _rewinding = c == command::rewind_start;
+                    // going back in time would leave frames in the movie that were never played
+                    if (_rewinding)
+                        stop_recording();
+                    changed = true;
+                    break;
+                case command::toggle_recording:
+                    if (_recording) {
+                        stop_recording();
+                    } else {
+                        start_recording();
+                    }
+                    changed = true;
+                    break;
+            }
+        }
+        return changed;
+    }
+
+    // frames end at vblank, so that the framebuffer published is a whole picture
+    void run_frame() {
+        _console.run_frame();
+        _console.save(*_state);
+        _history.push(*_state);
+    }
+
+    // a frame with the buttons the ui holds now, recorded when a movie is
+    void play_frame() {
+        input::movie_frame input{{_buttons.load(std::memory_order_relaxed), 0}};
+        _console.set_input(input);
+        if (_recording)
+            _movie.record(input);
+        run_frame();
+    }
+
+    // The newest state of the history is the current one and the framebuffer is not part of the states:
+    // load the state two frames back and run the frame in between again, only to draw it, then resume
+    // from the state recorded at the end of that frame, not from the re-run.
+    bool step_back() {
+        if (_history.size() < 3)
+            return false;
+        _history.pop(*_state);
+        _history.pop(*_previous);
+        _history.pop(*_state);
+        _console.load(*_state);
+        _history.push(*_state);
+        _console.run_frame();
+        _console.load(*_previous);
+        _history.push(*_previous);
+        return true;
+    }
+
+    void loop() {
+        _console.save(*_state);
+        _history.push(*_state);
+        publish_frame();
+        publish_snapshot();
+
+        auto deadline = clock::now();
+        while (!_quit.load(std::memory_order_relaxed)) {
+            if (handle_commands()) {
+                publish_frame();
+                publish_snapshot();
+            }
+
+            if (!_running && !_rewinding) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                deadline = clock::now();
+                continue;
+            }
+
+            if (_rewinding)
+                step_back();
+            else
+                play_frame();
+            publish_audio(!_rewinding);
+            publish_frame();
+            publish_snapshot();
+
+            deadline += frame_period;
+            auto now = clock::now();
+            if (now > deadline + max_late_frames * frame_period) {
+                SPDLOG_DEBUG("emulation {} frames late, skipping ahead", (now - deadline) / frame_period);
+                deadline = now;
+            }
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+
+    friend emulator;
+};
+
+emulator::emulator(std::shared_ptr<cartridge::rom const> rom) : _impl(new emulator_impl(std::move(rom))) {
+}
+
+emulator::~emulator() {
+    stop();
+}
+
+void emulator::start() {
+    if (_impl->_thread.joinable())
+        return;
+    _impl->_quit = false;
+    _impl->_thread = std::thread([this] { _impl->loop(); });
+}
+
+void emulator::stop() {
+    if (!_impl->_thread.joinable())
+        return;
+    _impl->_quit = true;
+    _impl->_thread.join();
+    _impl->stop_recording();
+}
+
+bool emulator::send(command c) {
+    return _impl->_commands.push(c);
+}
+
+void emulator::set_buttons(uint8_t buttons) noexcept {
+    _impl->_buttons.store(buttons, std::memory_order_relaxed);
+}
+
+void emulator::enable_snapshots(bool enabled) noexcept {
+    _impl->_snapshots.store(enabled, std::memory_order_relaxed);
+}
+
+bool emulator::poll_frame() noexcept {
+    return _impl->_frames.update();
+}
+
+frame const &emulator::current_frame() const noexcept {
+    return _impl->_frames.front();
+}
+
+bool emulator::poll_snapshot() noexcept {
+    return _impl->_debug.update();
+}
+
+debug_snapshot const &emulator::snapshot() const noexcept {
+    return _impl->_debug.front();
+}
+
+std::size_t emulator::read_audio(std::span<int16_t> out) noexcept {
+    std::size_t count = 0;
+    while (count < out.size() && _impl->_audio.pop(out[count]))
+        count++;
+    return count;
+}
@@ -0,0 +1,233 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "core/rewind.h"
+
+using namespace nes::core;
+
+namespace {
+    constexpr std::size_t state_size{sizeof(save_state)};
+    // shorter runs of unchanged bytes are cheaper to keep in the literal
+    constexpr std::size_t min_zero_run{4};
+
+    uint64_t load64(uint8_t const *p) noexcept {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    void put_varint(std::vector<uint8_t> &out, std::size_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80u));
+            value >>= 7u;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    std::size_t get_varint(uint8_t const *&in) noexcept {
+        std::size_t value = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            auto byte = *in++;
+            value |= static_cast<std::size_t>(byte & 0x7fu) << shift;
+            if (!(byte & 0x80u))
+                return value;
+        }
+    }
+
+    // (unchanged run, changed run) length pairs, each followed by the changed bytes xored with ref
+    void encode(uint8_t const *state, uint8_t const *ref, std::vector<uint8_t> &out) {
+        out.clear();
+        std::size_t i = 0;
+        while (i < state_size) {
+            auto zeros_start = i;
+            while (i + 8 <= state_size && load64(state + i) == load64(ref + i))
+                i += 8;
+            while (i < state_size && state[i] == ref[i])
+                i++;
+
+            auto literal_start = i;
+            while (i < state_size) {
+                if (state[i] != ref[i]) {
+                    i++;
+                    continue;
+                }
+                auto run_end = i;
+                while (run_end < state_size && run_end - i < min_zero_run && state[run_end] == ref[run_end])
+                    run_end++;
+                if (run_end - i >= min_zero_run || run_end == state_size)
+                    break;
+                i = run_end;
+            }
+
+            put_varint(out, literal_start - zeros_start);
+            put_varint(out, i - literal_start);
+            for (auto j = literal_start; j < i; j++)
+                out.push_back(state[j] ^ ref[j]);
+        }
+    }
+
+    void decode(uint8_t const *in, uint8_t const *ref, uint8_t *state) noexcept {
+        std::memcpy(state, ref, state_size);
+        std::size_t i = 0;
+        while (i < state_size) {
+            i += get_varint(in);
+            auto literal = get_varint(in);
+            for (std::size_t j = 0; j < literal; j++, i++)
+                state[i] ^= *in++;
+        }
+    }
+}
+
+struct nes::core::rewind_buffer_impl {
+private:
+    struct record {
+        std::size_t offset;
+        std::size_t size;
+        bool keyframe;
+    };
+
+    std::size_t _interval;
+    std::vector<uint8_t> _ring;
+    // oldest first
+    std::deque<record> _records;
+    std::size_t _bytes{0};
+    // the keyframe the newest records are relative to, and how many of them there are
+    std::unique_ptr<save_state> _keyframe{std::make_unique<save_state>()};
+    std::size_t _deltas{0};
+    std::vector<uint8_t> _zero = std::vector<uint8_t>(state_size);
+    std::vector<uint8_t> _scratch;
+
+    rewind_buffer_impl(std::size_t capacity, std::size_t interval) : _interval(std::max<std::size_t>(interval, 1)),
+                                                                    _ring(capacity) {
+        _scratch.reserve(state_size + state_size / 64);
+    }
+
+    [[nodiscard]] uint8_t const *keyframe_bytes() const noexcept {
+        return reinterpret_cast<uint8_t const *>(_keyframe.get());
+    }
+
+    void drop_oldest() noexcept {
+        _bytes -= _records.front().size;
+        _records.pop_front();
+        // the deltas of a dropped keyframe cannot be decoded anymore
+        while (!_records.empty() && !_records.front().keyframe) {
+            _bytes -= _records.front().size;
+            _records.pop_front();
+        }
+    }
+
+    // copy the scratch encoding into the ring, after the newest record or at the start of the ring
+    void place(bool keyframe) {
+        auto size = _scratch.size();
+        std::size_t offset = 0;
+        if (!_records.empty() && _records.back().offset + _records.back().size + size <= _ring.size())
+            offset = _records.back().offset + _records.back().size;
+
+        // records are dropped oldest first until none of them overlaps the new one
+        std::size_t overlapping = 0;
+        for (std::size_t i = 0; i < _records.size(); i++) {
+            auto const &r = _records[i];
+            if (r.offset < offset + size && offset < r.offset + r.size)
+                overlapping = i + 1;
+        }
+        auto keep = _records.size() - overlapping;
+        while (_records.size() > keep)
+            drop_oldest();
+
+        std::memcpy(_ring.data() + offset, _scratch.data(), size);
+        _records.push_back(record{offset, size, keyframe});
+        _bytes += size;
+    }
+
+    void push(save_state const &state) {
+        auto bytes = reinterpret_cast<uint8_t const *>(&state);
+        if (_records.empty() || _deltas + 1 >= _interval) {
+            push_keyframe(state);
+            return;
+        }
+
+        encode(bytes, keyframe_bytes(), _scratch);
+        if (_scratch.size() > _ring.size())
+            return;
+        place(false);
+        // the ring is too small for a whole keyframe interval: the delta lost its keyframe
+        if (_records.size() == 1) {
+            _records.clear();
+            _bytes = 0;
+            push_keyframe(state);
+            return;
+        }
+        _deltas++;
+    }
+
+    void push_keyframe(save_state const &state) {
+        encode(reinterpret_cast<uint8_t const *>(&state), _zero.data(), _scratch);
+        if (_scratch.size() > _ring.size())
+            return;
+        place(true);
+        *_keyframe = state;
+        _deltas = 0;
+    }
+
+    bool pop(save_state &state) {
+        if (_records.empty())
+            return false;
+
+        auto r = _records.back();
+        _records.pop_back();
+        _bytes -= r.size;
+        if (!r.keyframe) {
+            decode(_ring.data() + r.offset, keyframe_bytes(), reinterpret_cast<uint8_t *>(&state));
+            _deltas--;
+            return true;
+        }
+
+        state = *_keyframe;
+        // the newest remaining records are relative to the previous keyframe
+        _deltas = 0;
+        for (auto it = _records.rbegin(); it != _records.rend(); ++it) {
+            if (it->keyframe) {
+                decode(_ring.data() + it->offset, _zero.data(), reinterpret_cast<uint8_t *>(_keyframe.get()));
+                break;
+            }
+            _deltas++;
+        }
+        return true;
+    }
+
+    friend rewind_buffer;
+};
+
+rewind_buffer::rewind_buffer(std::size_t capacity, std::size_t keyframe_interval) : _impl(
+        new rewind_buffer_impl(capacity, keyframe_interval)) {
+}
+
+rewind_buffer::~rewind_buffer() = default;
+
+void rewind_buffer::push(save_state const &state) {
+    _impl->push(state);
+}
+
+bool rewind_buffer::pop(save_state &state) {
+    return _impl->pop(state);
+}
+
+void rewind_buffer::clear() noexcept {
+    _impl->_records.clear();
+    _impl->_bytes = 0;
+    _impl->_deltas = 0;
+}
+
+std::size_t rewind_buffer::size() const noexcept {
+    return _impl->_records.size();
+}
+
+std::size_t rewind_buffer::bytes() const noexcept {
+    return _impl->_bytes;
+}
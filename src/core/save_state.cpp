@@ -0,0 +1,27 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <fstream>
+
+#include <fmt/format.h>
+
+#include "core/save_state.h"
+
+using namespace nes::core;
+
+void nes::core::write_state(std::filesystem::path const &path, save_state const &state) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<char const *>(&state), sizeof(state));
+    if (!out)
+        throw state_error(fmt::format("cannot write {}", path.string()));
+}
+
+void nes::core::read_state(std::filesystem::path const &path, save_state &state) {
+    std::ifstream in(path, std::ios::binary);
+    in.read(reinterpret_cast<char *>(&state), sizeof(state));
+    if (!in)
+        throw state_error(fmt::format("cannot read {}", path.string()));
+    if (state.tag != save_state::magic || state.version != save_state::current_version)
+        throw state_error(fmt::format("{} is not a version {} save state", path.string(), save_state::current_version));
+}
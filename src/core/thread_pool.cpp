@@ -0,0 +1,138 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/thread_pool.h"
+
+using namespace nes::core;
+
+namespace {
+    // index of the worker running on this thread, in the pool it belongs to
+    thread_local thread_pool_impl const *current_pool{nullptr};
+    thread_local std::size_t current_worker{0};
+}
+
+struct nes::core::thread_pool_impl {
+private:
+    struct worker_queue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::atomic<std::size_t> _next{0};
+    // tasks sitting in a queue, and tasks submitted but not completed
+    std::atomic<std::size_t> _queued{0};
+    std::atomic<std::size_t> _pending{0};
+    bool _stop{false};
+    std::mutex _lock;
+    std::condition_variable _work;
+    std::condition_variable _done;
+
+    bool pop(std::size_t worker, std::function<void()> &task) {
+        // own queue first, newest task
+        {
+            auto &q = *_queues[worker];
+            std::lock_guard guard(q.lock);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        // then steal the oldest task of another worker
+        for (std::size_t i = 1; i < _queues.size(); i++) {
+            auto &q = *_queues[(worker + i) % _queues.size()];
+            std::lock_guard guard(q.lock);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(std::size_t worker) {
+        current_pool = this;
+        current_worker = worker;
+
+        std::function<void()> task;
+        while (true) {
+            if (pop(worker, task)) {
+                _queued.fetch_sub(1, std::memory_order_relaxed);
+                task();
+                task = nullptr;
+                if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard guard(_lock);
+                    _done.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock guard(_lock);
+            _work.wait(guard, [this] { return _stop || _queued.load(std::memory_order_relaxed) != 0; });
+            if (_stop && _queued.load(std::memory_order_relaxed) == 0)
+                return;
+        }
+    }
+
+    friend thread_pool;
+};
+
+thread_pool::thread_pool(std::size_t threads) : _impl(std::make_unique<thread_pool_impl>()) {
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < threads; i++)
+        _impl->_queues.push_back(std::make_unique<thread_pool_impl::worker_queue>());
+    for (std::size_t i = 0; i < threads; i++)
+        _impl->_workers.emplace_back([this, i] { _impl->run(i); });
+}
+
+thread_pool::~thread_pool() {
+    wait();
+    {
+        std::lock_guard guard(_impl->_lock);
+        _impl->_stop = true;
+    }
+    _impl->_work.notify_all();
+    for (auto &worker : _impl->_workers)
+        worker.join();
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    auto &impl = *_impl;
+    auto worker = current_pool == &impl ? current_worker
+                                        : impl._next.fetch_add(1, std::memory_order_relaxed) % impl._queues.size();
+
+    impl._pending.fetch_add(1, std::memory_order_relaxed);
+    // counted before it is visible so that _queued never goes below the number of queued tasks
+    {
+        std::lock_guard guard(impl._lock);
+        impl._queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        auto &q = *impl._queues[worker];
+        std::lock_guard guard(q.lock);
+        q.tasks.push_back(std::move(task));
+    }
+    impl._work.notify_one();
+}
+
+void thread_pool::wait() {
+    std::unique_lock guard(_impl->_lock);
+    _impl->_done.wait(guard, [this] { return _impl->_pending.load(std::memory_order_acquire) == 0; });
+}
+
+std::size_t thread_pool::size() const noexcept {
+    return _impl->_workers.size();
+}
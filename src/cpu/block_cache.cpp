@@ -0,0 +1,78 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <spdlog/spdlog.h>
+
+#include "cpu/block_cache.h"
+
+using namespace nes::cpu;
+
+static bool ends_block(opcode op) {
+    switch (op) {
+        case opcode::BPL:
+        case opcode::BMI:
+        case opcode::BVC:
+        case opcode::BVS:
+        case opcode::BCC:
+        case opcode::BCS:
+        case opcode::BNE:
+        case opcode::BEQ:
+        case opcode::JMP:
+        case opcode::JSR:
+        case opcode::RTS:
+        case opcode::RTI:
+        case opcode::BRK:
+        case opcode::ILL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+block_cache::block_cache(cpu_mem_bus &membus) : _membus(membus), _blocks(entries) {
+}
+
+block_cache::block const &block_cache::lookup(uint16_t pc) {
+    auto &b = _blocks[index(pc)];
+    if (b.pc == pc && valid(b)) [[likely]] {
+        _hits++;
+        return b;
+    }
+
+    _misses++;
+    auto page = static_cast<uint8_t>(pc >> 8u);
+    b.pc = pc;
+    b.size = 0;
+    b.page = _membus.read_page(page);
+
+    if (b.page) {
+        _membus.watch_page(page);
+        b.generation = _membus.page_generation(page);
+
+        for (uint16_t addr = pc; b.size < max_block_size && (addr >> 8u) == page;) {
+            auto op = decoder::decode(addr, _membus);
+            if ((addr & 0xffu) + op.bytes > 0x100u)
+                break;
+            b.ops[b.size++] = op;
+            addr += op.bytes;
+            if (ends_block(op.op))
+                break;
+        }
+    }
+
+    if (b.size)
+        return b;
+
+    SPDLOG_TRACE("uncached code at {:#06x}", pc);
+    b.page = nullptr;
+    _uncached.pc = pc;
+    _uncached.size = 1;
+    _uncached.ops[0] = decoder::decode(pc, _membus);
+    return _uncached;
+}
+
+void block_cache::clear() noexcept {
+    for (auto &b : _blocks)
+        b.page = nullptr;
+}
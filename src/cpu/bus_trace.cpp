@@ -0,0 +1,34 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <bit>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "cpu/bus_trace.h"
+
+using namespace nes::cpu;
+
+bus_trace::bus_trace(std::size_t capacity) : _events(std::bit_ceil(capacity)), _mask(_events.size() - 1) {
+}
+
+void bus_trace::save(std::filesystem::path const &path) const {
+    std::ofstream file(path, std::ios::binary);
+
+    auto first = _head - size();
+    auto begin = first & _mask;
+    auto end = _head & _mask;
+    auto data = reinterpret_cast<char const *>(_events.data());
+
+    // the ring is at most in two contiguous parts
+    if (begin < end || size() == 0) {
+        file.write(data + begin * sizeof(bus_event), (end - begin) * sizeof(bus_event));
+    } else {
+        file.write(data + begin * sizeof(bus_event), (_events.size() - begin) * sizeof(bus_event));
+        file.write(data, end * sizeof(bus_event));
+    }
+
+    spdlog::info("saved {} bus events to {} ({} dropped)", size(), path.string(), dropped());
+}
@@ -0,0 +1,150 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <spdlog/spdlog.h>
+
+#include "cpu/cpu.h"
+
+using namespace nes::cpu;
+
+cpu::cpu(cpu_mem_bus &membus, scheduler &scheduler) : _membus(membus), _scheduler(scheduler), _blocks(membus),
+                                                      _execute(membus, _regs) {
+    reset();
+}
+
+cpu::~cpu() = default;
+
+void cpu::reset() {
+    // the reset sequence takes 7 cycles, the clock keeps counting across resets
+    _scheduler.reset(_scheduler.now() + 7);
+    _regs.pc = _membus.fetch_u16(0xfffc);
+    _regs.sr = flag::unused | flag::irq_disable;
+    _regs.sp = 0xfd;
+    _block = nullptr;
+}
+
+uint32_t cpu::step() {
+    auto start = _scheduler.now();
+    execute_next();
+    _scheduler.sync();
+    return static_cast<uint32_t>(_scheduler.now() - start);
+}
+
+decoded_op const &cpu::fetch_next() {
+    // while tracing, every instruction is fetched through the bus as it runs, so that the trace sees
+    // its opcode and operand reads in order
+    if (_membus.tracing()) [[unlikely]] {
+        _block = nullptr;
+        _traced = decoder::decode(_regs.pc, _membus);
+        return _traced;
+    }
+
+    if (!_block || _index >= _block->size || _regs.pc != _next_pc || !_blocks.valid(*_block)) {
+        _block = &_blocks.lookup(_regs.pc);
+        _index = 0;
+    }
+    return _block->ops[_index++];
+}
+
+void cpu::execute_next() {
+    auto const &op = fetch_next();
+    if (op.op == opcode::ILL)
+        SPDLOG_DEBUG("illegal opcode {:#04x} at {:#06x}", _membus.fetch_u8(_regs.pc), _regs.pc);
+
+    _regs.pc += op.bytes;
+    _next_pc = _regs.pc;
+    if (_scheduler.advance(_execute.exec(op)) || irq_unmasked())
+        poll_interrupts();
+
+    _instructions++;
+}
+
+bool cpu::run_jit() {
+    auto instructions = _jit->run();
+    if (!instructions)
+        return false;
+
+    // the block has already advanced the clock up to its last io access
+    if (_scheduler.advance(_jit->cycles() - _jit->synced()) || irq_unmasked())
+        poll_interrupts();
+    _instructions += instructions;
+    return true;
+}
+
+uint8_t cpu::poll_interrupts() {
+    // the nmi wins over the irq, which stays pending while masked
+    auto lines = _scheduler.poll();
+    uint16_t vector;
+    if (lines.nmi)
+        vector = 0xfffa;
+    else if (lines.irq && !(_regs.sr & flag::irq_disable))
+        vector = 0xfffe;
+    else
+        return 0;
+
+    auto cycles = _execute.interrupt(vector);
+    _scheduler.advance(cycles);
+    return cycles;
+}
+
+uint64_t cpu::run(uint64_t cycle_budget) {
+    auto start = _scheduler.now();
+    auto target = start + cycle_budget;
+
+    // translated blocks read ram straight from host memory, out of sight of a bus trace
+    if (_jit && !_membus.tracing()) {
+        while (_scheduler.now() < target)
+            if (!run_jit())
+                execute_next();
+    } else {
+        while (_scheduler.now() < target)
+            execute_next();
+    }
+
+    _scheduler.sync();
+    return _scheduler.now() - start;
+}
+
+uint64_t cpu::cycles() const noexcept {
+    return _scheduler.now();
+}
+
+uint64_t cpu::instructions() const noexcept {
+    return _instructions;
+}
+
+block_cache const &cpu::blocks() const noexcept {
+    return _blocks;
+}
+
+void cpu::save(cpu_state &state) const noexcept {
+    state.r = _regs;
+    state.cycles = _scheduler.now();
+    state.instructions = _instructions;
+}
+
+void cpu::load(cpu_state const &state) noexcept {
+    _regs = state.r;
+    _scheduler.rebase(state.cycles);
+    _instructions = state.instructions;
+    _block = nullptr;
+}
+
+bool cpu::enable_jit(bool enabled) {
+    if (!enabled || !jit::supported()) {
+        _jit.reset();
+        return false;
+    }
+    if (!_jit)
+        _jit = std::make_unique<jit>(_regs, _membus, _scheduler, _blocks);
+    return true;
+}
+
+bool cpu::jit_enabled() const noexcept {
+    return _jit != nullptr;
+}
+
+uint64_t cpu::translated_blocks() const noexcept {
+    return _jit ? _jit->translated_blocks() : 0;
+}
@@ -6,42 +6,255 @@
 
 using namespace nes::cpu;
 
-class nes::cpu::execute_impl {
-private:
-    std::shared_ptr<cpu_mem_bus> _membus;
-    std::shared_ptr<regs> _regs;
-
-    friend execute;
-};
+execute::execute(cpu_mem_bus &membus, regs &regs) noexcept: _membus(membus), _regs(regs) {
+}
 
-uint8_t nes::cpu::execute::exec(nes::cpu::decoded_op &op) {
+uint8_t execute::exec(decoded_op const &op) {
+    auto &r = _regs;
+    auto &membus = _membus;
     uint8_t cycles = op.cycles;
+    auto addr = address(op, cycles);
 
     switch (op.op) {
-        case opcode::SEI:
-            _impl->_regs->flags |= 0x4u;
-            break;
-        case opcode::CLD:
-            _impl->_regs->flags &= ~0x8u;
+        // loads, stores and transfers
+        case opcode::LDA:
+            r.ac = read(op, addr);
+            set_nz(r.ac);
             break;
         case opcode::LDX:
-            _impl->_regs->x = op.val;
+            r.x = read(op, addr);
+            set_nz(r.x);
+            break;
+        case opcode::LDY:
+            r.y = read(op, addr);
+            set_nz(r.y);
+            break;
+        case opcode::STA:
+            membus.store(addr, r.ac);
             break;
         case opcode::STX:
-            _impl->_regs->sp = _impl->_regs->x;
+            membus.store(addr, r.x);
             break;
-        case opcode::LDA:
-            _impl->_regs->ac = op.val;
+        case opcode::STY:
+            membus.store(addr, r.y);
+            break;
+        case opcode::TAX:
+            r.x = r.ac;
+            set_nz(r.x);
+            break;
+        case opcode::TAY:
+            r.y = r.ac;
+            set_nz(r.y);
+            break;
+        case opcode::TSX:
+            r.x = r.sp;
+            set_nz(r.x);
+            break;
+        case opcode::TXA:
+            r.ac = r.x;
+            set_nz(r.ac);
+            break;
+        case opcode::TXS:
+            r.sp = r.x;
+            break;
+        case opcode::TYA:
+            r.ac = r.y;
+            set_nz(r.ac);
+            break;
+
+        // stack
+        case opcode::PHA:
+            push(r.ac);
+            break;
+        case opcode::PHP:
+            push(r.sr | flag::brk | flag::unused);
+            break;
+        case opcode::PLA:
+            r.ac = pull();
+            set_nz(r.ac);
+            break;
+        case opcode::PLP:
+            r.sr = (pull() & ~flag::brk) | flag::unused;
+            break;
+
+        // arithmetic and logic
+        case opcode::ADC:
+            adc(read(op, addr));
+            break;
+        case opcode::SBC:
+            adc(read(op, addr) ^ 0xffu);
+            break;
+        case opcode::AND:
+            r.ac &= read(op, addr);
+            set_nz(r.ac);
+            break;
+        case opcode::ORA:
+            r.ac |= read(op, addr);
+            set_nz(r.ac);
+            break;
+        case opcode::EOR:
+            r.ac ^= read(op, addr);
+            set_nz(r.ac);
+            break;
+        case opcode::BIT: {
+            auto value = read(op, addr);
+            set_flag(flag::zero, (r.ac & value) == 0);
+            set_flag(flag::overflow, value & 0x40u);
+            set_flag(flag::negative, value & 0x80u);
+            break;
+        }
+        case opcode::CMP:
+            compare(r.ac, read(op, addr));
+            break;
+        case opcode::CPX:
+            compare(r.x, read(op, addr));
+            break;
+        case opcode::CPY:
+            compare(r.y, read(op, addr));
+            break;
+
+        // increments and decrements
+        case opcode::INC:
+            read_modify_write(op, addr, [this](uint8_t v) {
+                v++;
+                set_nz(v);
+                return v;
+            });
+            break;
+        case opcode::DEC:
+            read_modify_write(op, addr, [this](uint8_t v) {
+                v--;
+                set_nz(v);
+                return v;
+            });
+            break;
+        case opcode::INX:
+            set_nz(++r.x);
+            break;
+        case opcode::INY:
+            set_nz(++r.y);
+            break;
+        case opcode::DEX:
+            set_nz(--r.x);
+            break;
+        case opcode::DEY:
+            set_nz(--r.y);
+            break;
+
+        // shifts and rotates
+        case opcode::ASL:
+            read_modify_write(op, addr, [this](uint8_t v) {
+                set_flag(flag::carry, v & 0x80u);
+                v <<= 1u;
+                set_nz(v);
+                return v;
+            });
+            break;
+        case opcode::LSR:
+            read_modify_write(op, addr, [this](uint8_t v) {
+                set_flag(flag::carry, v & 0x01u);
+                v >>= 1u;
+                set_nz(v);
+                return v;
+            });
+            break;
+        case opcode::ROL:
+            read_modify_write(op, addr, [this, &r](uint8_t v) {
+                uint8_t carry = r.sr & flag::carry;
+                set_flag(flag::carry, v & 0x80u);
+                v = (v << 1u) | carry;
+                set_nz(v);
+                return v;
+            });
+            break;
+        case opcode::ROR:
+            read_modify_write(op, addr, [this, &r](uint8_t v) {
+                uint8_t carry = r.sr & flag::carry;
+                set_flag(flag::carry, v & 0x01u);
+                v = (v >> 1u) | (carry << 7u);
+                set_nz(v);
+                return v;
+            });
+            break;
+
+        // jumps and calls
+        case opcode::JMP:
+            r.pc = addr;
+            break;
+        case opcode::JSR:
+            push16(r.pc - 1);
+            r.pc = op.addr;
+            break;
+        case opcode::RTS:
+            r.pc = pull16() + 1;
+            break;
+        case opcode::BRK:
+            push16(r.pc + 1);
+            push(r.sr | flag::brk | flag::unused);
+            r.sr |= flag::irq_disable;
+            r.pc = membus.fetch_u16(0xfffe);
             break;
-        default:
+        case opcode::RTI:
+            r.sr = (pull() & ~flag::brk) | flag::unused;
+            r.pc = pull16();
+            break;
+
+        // branches
+        case opcode::BPL:
+            return branch(op, !(r.sr & flag::negative));
+        case opcode::BMI:
+            return branch(op, r.sr & flag::negative);
+        case opcode::BVC:
+            return branch(op, !(r.sr & flag::overflow));
+        case opcode::BVS:
+            return branch(op, r.sr & flag::overflow);
+        case opcode::BCC:
+            return branch(op, !(r.sr & flag::carry));
+        case opcode::BCS:
+            return branch(op, r.sr & flag::carry);
+        case opcode::BNE:
+            return branch(op, !(r.sr & flag::zero));
+        case opcode::BEQ:
+            return branch(op, r.sr & flag::zero);
+
+        // status flags
+        case opcode::CLC:
+            r.sr &= ~flag::carry;
+            break;
+        case opcode::SEC:
+            r.sr |= flag::carry;
+            break;
+        case opcode::CLI:
+            r.sr &= ~flag::irq_disable;
+            break;
+        case opcode::SEI:
+            r.sr |= flag::irq_disable;
+            break;
+        case opcode::CLV:
+            r.sr &= ~flag::overflow;
+            break;
+        case opcode::CLD:
+            r.sr &= ~flag::decimal;
+            break;
+        case opcode::SED:
+            r.sr |= flag::decimal;
+            break;
+
+        case opcode::NOP:
+        case opcode::ILL:
             break;
     }
 
     return cycles;
 }
 
-execute::execute(std::shared_ptr<cpu_mem_bus> membus, std::shared_ptr<regs> regs) : _impl(
-        std::make_unique<execute_impl>()) {
-    _impl->_membus = std::move(membus);
-    _impl->_regs = std::move(regs);
+uint8_t execute::interrupt(uint16_t vector) {
+    auto &r = _regs;
+
+    push16(r.pc);
+    push((r.sr & ~flag::brk) | flag::unused);
+    r.sr |= flag::irq_disable;
+    r.pc = _membus.fetch_u16(vector);
+
+    return 7;
 }
@@ -0,0 +1,1207 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include "cpu/jit.h"
+
+#if defined(__x86_64__) && defined(__unix__) && !defined(NES_TRACE)
+#define NES_JIT_X86_64 1
+#endif
+
+#ifdef NES_JIT_X86_64
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+using namespace nes::cpu;
+
+namespace {
+    // state shared between the generated code and the helpers it calls, passed in rdi
+    struct jit_context {
+        regs *r;
+        cpu_mem_bus *membus;
+        scheduler *clock;
+        uint8_t const *ram;
+        uint64_t cycles;
+        uint64_t synced;
+    };
+
+    // ppu and apu/io reads need the clock at the current cycle, the bus then catches the ppu and the apu up
+    bool read_needs_sync(uint32_t addr) noexcept {
+        auto type = addr_to_mem_type(static_cast<uint16_t>(addr));
+        return type == mem_type::ppu || type == mem_type::apu || type == mem_type::none;
+    }
+
+    void sync(jit_context *c) {
+        c->clock->advance(c->cycles - c->synced);
+        c->synced = c->cycles;
+    }
+
+    uint32_t jit_read(jit_context *c, uint32_t addr) {
+        if (read_needs_sync(addr))
+            sync(c);
+        return c->membus->fetch_u8(static_cast<uint16_t>(addr));
+    }
+
+    // return true when the block has to stop: a mapper register write may have switched the code
+    uint32_t jit_write(jit_context *c, uint32_t addr, uint32_t value) {
+        // mapper registers switch chr banks under the ppu as well
+        if (addr >= 0x2000)
+            sync(c);
+        c->membus->store(static_cast<uint16_t>(addr), static_cast<uint8_t>(value));
+        return addr >= 0x8000;
+    }
+
+    void jit_push(jit_context *c, uint32_t value) {
+        c->membus->store(static_cast<uint16_t>(0x100u | c->r->sp), static_cast<uint8_t>(value));
+        c->r->sp--;
+    }
+
+    uint32_t jit_pull(jit_context *c) {
+        c->r->sp++;
+        return c->membus->fetch_u8(static_cast<uint16_t>(0x100u | c->r->sp));
+    }
+
+    // negative and zero flags of every byte value
+    constexpr std::array<uint8_t, 256> make_nz_table() {
+        std::array<uint8_t, 256> table{};
+        for (unsigned v = 0; v < 256; v++)
+            table[v] = (v == 0 ? flag::zero : 0) | (v & flag::negative);
+        return table;
+    }
+
+    constexpr std::array<uint8_t, 256> nz_table = make_nz_table();
+
+    enum reg : uint8_t {
+        rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8, r9, r10, r11, r12, r13, r14, r15
+    };
+
+    // host register allocation while a block runs
+    constexpr reg ctx{rbx};
+    constexpr reg nz{rbp};
+    constexpr reg ra{r12};
+    constexpr reg rx{r13};
+    constexpr reg ry{r14};
+    constexpr reg rp{r15};
+
+    enum cond : uint8_t {
+        cc_ae = 0x3,
+        cc_e = 0x4,
+        cc_ne = 0x5,
+        cc_a = 0x7,
+    };
+
+    // a minimal x86-64 encoder: 32 bits operations on registers, 8/16/64 bits memory operands
+    // addressed as [base + disp32] or [base + index], and rel32 jumps
+    class emitter {
+    public:
+        std::vector<uint8_t> code;
+
+        void byte(uint8_t b) {
+            code.push_back(b);
+        }
+
+        void imm16(uint16_t v) {
+            byte(v & 0xffu);
+            byte(v >> 8u);
+        }
+
+        void imm32(uint32_t v) {
+            for (int i = 0; i < 4; i++)
+                byte((v >> (i * 8)) & 0xffu);
+        }
+
+        void imm64(uint64_t v) {
+            imm32(static_cast<uint32_t>(v));
+            imm32(static_cast<uint32_t>(v >> 32u));
+        }
+
+        // byte_reg: the operand is a byte register, spl/bpl/sil/dil need a rex prefix
+        void rex(bool w, unsigned r, unsigned b, bool byte_reg = false, unsigned x = 0) {
+            uint8_t v = 0x40u | (w << 3u) | (((r >> 3u) & 1u) << 2u) | (((x >> 3u) & 1u) << 1u) | ((b >> 3u) & 1u);
+            if (v != 0x40u || (byte_reg && b >= 4 && b < 8))
+                byte(v);
+        }
+
+        void modrm_rr(unsigned r, unsigned rm) {
+            byte(0xc0u | ((r & 7u) << 3u) | (rm & 7u));
+        }
+
+        void modrm_mem(unsigned r, unsigned base, int32_t disp) {
+            byte(0x80u | ((r & 7u) << 3u) | (base & 7u));
+            if ((base & 7u) == rsp)
+                byte(0x24);
+            imm32(static_cast<uint32_t>(disp));
+        }
+
+        // opcode in its "r/m32, r32" form
+        void op_rr(uint8_t opcode, reg dst, reg src) {
+            rex(false, src, dst);
+            byte(opcode);
+            modrm_rr(src, dst);
+        }
+
+        void mov(reg dst, reg src) { op_rr(0x89, dst, src); }
+
+        void add(reg dst, reg src) { op_rr(0x01, dst, src); }
+
+        void or_(reg dst, reg src) { op_rr(0x09, dst, src); }
+
+        void and_(reg dst, reg src) { op_rr(0x21, dst, src); }
+
+        void sub(reg dst, reg src) { op_rr(0x29, dst, src); }
+
+        void xor_(reg dst, reg src) { op_rr(0x31, dst, src); }
+
+        void cmp(reg dst, reg src) { op_rr(0x39, dst, src); }
+
+        void test(reg dst, reg src) { op_rr(0x85, dst, src); }
+
+        void test(reg dst, uint32_t imm) {
+            rex(false, 0, dst);
+            byte(0xf7);
+            modrm_rr(0, dst);
+            imm32(imm);
+        }
+
+        void mov64(reg dst, reg src) {
+            rex(true, src, dst);
+            byte(0x89);
+            modrm_rr(src, dst);
+        }
+
+        // group 1 operation with an immediate, ext is the /digit
+        void op_ri(unsigned ext, reg dst, int32_t imm) {
+            rex(false, 0, dst);
+            if (imm >= -128 && imm <= 127) {
+                byte(0x83);
+                modrm_rr(ext, dst);
+                byte(static_cast<uint8_t>(imm));
+            } else {
+                byte(0x81);
+                modrm_rr(ext, dst);
+                imm32(static_cast<uint32_t>(imm));
+            }
+        }
+
+        void add(reg dst, int32_t imm) { op_ri(0, dst, imm); }
+
+        void or_(reg dst, int32_t imm) { op_ri(1, dst, imm); }
+
+        void and_(reg dst, int32_t imm) { op_ri(4, dst, imm); }
+
+        void xor_(reg dst, int32_t imm) { op_ri(6, dst, imm); }
+
+        void cmp(reg dst, int32_t imm) { op_ri(7, dst, imm); }
+
+        void mov(reg dst, uint32_t imm) {
+            rex(false, 0, dst);
+            byte(0xb8u + (dst & 7u));
+            imm32(imm);
+        }
+
+        void mov64(reg dst, uint64_t imm) {
+            rex(true, 0, dst);
+            byte(0xb8u + (dst & 7u));
+            imm64(imm);
+        }
+
+        void shl(reg dst, uint8_t count) {
+            rex(false, 0, dst);
+            byte(0xc1);
+            modrm_rr(4, dst);
+            byte(count);
+        }
+
+        void shr(reg dst, uint8_t count) {
+            rex(false, 0, dst);
+            byte(0xc1);
+            modrm_rr(5, dst);
+            byte(count);
+        }
+
+        void not_(reg dst) {
+            rex(false, 0, dst);
+            byte(0xf7);
+            modrm_rr(2, dst);
+        }
+
+        // movzx dst, src8
+        void movzx8(reg dst, reg src) {
+            rex(false, dst, src, true);
+            byte(0x0f);
+            byte(0xb6);
+            modrm_rr(dst, src);
+        }
+
+        void setcc(cond c, reg dst) {
+            rex(false, 0, dst, true);
+            byte(0x0f);
+            byte(0x90u + c);
+            modrm_rr(0, dst);
+        }
+
+        // mov dst64, [base + disp]
+        void load64(reg dst, reg base, int32_t disp) {
+            rex(true, dst, base);
+            byte(0x8b);
+            modrm_mem(dst, base, disp);
+        }
+
+        // mov dst32, [base + disp]
+        void load32(reg dst, reg base, int32_t disp) {
+            rex(false, dst, base);
+            byte(0x8b);
+            modrm_mem(dst, base, disp);
+        }
+
+        // mov [base + disp], src32
+        void store32(reg base, int32_t disp, reg src) {
+            rex(false, src, base);
+            byte(0x89);
+            modrm_mem(src, base, disp);
+        }
+
+        // movzx dst32, byte [base + disp]
+        void load8(reg dst, reg base, int32_t disp) {
+            rex(false, dst, base);
+            byte(0x0f);
+            byte(0xb6);
+            modrm_mem(dst, base, disp);
+        }
+
+        // movzx dst32, byte [base + index]
+        void load8(reg dst, reg base, reg index) {
+            rex(false, dst, base, false, index);
+            byte(0x0f);
+            byte(0xb6);
+            byte(0x44u | ((dst & 7u) << 3u));
+            byte(((index & 7u) << 3u) | (base & 7u));
+            byte(0x00);
+        }
+
+        // mov byte [base + disp], src8
+        void store8(reg base, int32_t disp, reg src) {
+            rex(false, src, base, src >= 4 && src < 8);
+            byte(0x88);
+            modrm_mem(src, base, disp);
+        }
+
+        // mov word [base + disp], src16
+        void store16(reg base, int32_t disp, reg src) {
+            byte(0x66);
+            rex(false, src, base);
+            byte(0x89);
+            modrm_mem(src, base, disp);
+        }
+
+        // mov word [base + disp], imm16
+        void store16(reg base, int32_t disp, uint16_t imm) {
+            byte(0x66);
+            rex(false, 0, base);
+            byte(0xc7);
+            modrm_mem(0, base, disp);
+            imm16(imm);
+        }
+
+        // add qword [base + disp], imm32
+        void add_mem64(reg base, int32_t disp, int32_t imm) {
+            rex(true, 0, base);
+            byte(0x81);
+            modrm_mem(0, base, disp);
+            imm32(static_cast<uint32_t>(imm));
+        }
+
+        // add qword [base + disp], src64
+        void add_mem64(reg base, int32_t disp, reg src) {
+            rex(true, src, base);
+            byte(0x01);
+            modrm_mem(src, base, disp);
+        }
+
+        void push(reg r) {
+            rex(false, 0, r);
+            byte(0x50u + (r & 7u));
+        }
+
+        void pop(reg r) {
+            rex(false, 0, r);
+            byte(0x58u + (r & 7u));
+        }
+
+        // add/sub rsp, imm8
+        void adjust_rsp(int8_t delta) {
+            byte(0x48);
+            byte(0x83);
+            modrm_rr(delta < 0 ? 5 : 0, rsp);
+            byte(static_cast<uint8_t>(delta < 0 ? -delta : delta));
+        }
+
+        void ret() {
+            byte(0xc3);
+        }
+
+        template<typename Fn>
+        void call(Fn *fn) {
+            mov64(rax, reinterpret_cast<uint64_t>(fn));
+            byte(0xff);
+            modrm_rr(2, rax);
+        }
+
+        // forward jumps, return the offset to patch with bind()
+        std::size_t jcc(cond c) {
+            byte(0x0f);
+            byte(0x80u + c);
+            imm32(0);
+            return code.size() - 4;
+        }
+
+        void bind(std::size_t rel) {
+            auto target = static_cast<int32_t>(code.size() - (rel + 4));
+            std::memcpy(&code[rel], &target, sizeof(target));
+        }
+
+        void jmp(std::size_t target) {
+            byte(0xe9);
+            imm32(static_cast<uint32_t>(static_cast<int32_t>(target - (code.size() + 4))));
+        }
+    };
+
+    constexpr int32_t ctx_regs = offsetof(jit_context, r);
+    constexpr int32_t ctx_ram = offsetof(jit_context, ram);
+    constexpr int32_t ctx_cycles = offsetof(jit_context, cycles);
+    constexpr int32_t regs_pc = offsetof(regs, pc);
+    constexpr int32_t regs_ac = offsetof(regs, ac);
+    constexpr int32_t regs_x = offsetof(regs, x);
+    constexpr int32_t regs_y = offsetof(regs, y);
+    constexpr int32_t regs_sr = offsetof(regs, sr);
+    constexpr int32_t regs_sp = offsetof(regs, sp);
+
+    using block_fn = uint32_t (*)(jit_context *);
+
+    // Translation of one block. Cycles are accumulated at translation time and only added to the
+    // context before io accesses and exits. Like the interpreter, which advances the clock after each
+    // instruction, an access sees the ppu as it was before the instruction started.
+    class translator {
+    public:
+        explicit translator(emitter &e) : _e(e) {}
+
+        // return the number of instructions translated, 0 when the first one is not supported
+        std::size_t translate(block_cache::block const &block) {
+            emit_epilogue();
+            _entry = _e.code.size();
+            emit_prologue();
+
+            uint16_t pc = block.pc;
+            std::size_t count = 0;
+            for (; count < block.size; count++) {
+                auto const &op = block.ops[count];
+                if (!supported(op))
+                    break;
+                _count = count + 1;
+                _next = static_cast<uint16_t>(pc + op.bytes);
+                if (!emit(op, pc))
+                    return count + 1;
+                pc = _next;
+            }
+
+            if (count)
+                exit(pc, count);
+            return count;
+        }
+
+        [[nodiscard]] std::size_t entry() const noexcept {
+            return _entry;
+        }
+
+    private:
+        static bool supported(decoded_op const &op) {
+            switch (op.op) {
+                case opcode::BRK:
+                case opcode::RTI:
+                case opcode::ILL:
+                    return false;
+                case opcode::JMP:
+                    return op.mode == address_mode::Abs;
+                default:
+                    return true;
+            }
+        }
+
+        // the epilogue is emitted first so that exits are backward jumps. edx holds the instruction count
+        void emit_epilogue() {
+            _epilogue = _e.code.size();
+            _e.load64(rax, ctx, ctx_regs);
+            _e.store8(rax, regs_ac, ra);
+            _e.store8(rax, regs_x, rx);
+            _e.store8(rax, regs_y, ry);
+            _e.store8(rax, regs_sr, rp);
+            _e.mov(rax, rdx);
+            _e.adjust_rsp(24);
+            for (auto r : {r15, r14, r13, r12, rbp, rbx})
+                _e.pop(r);
+            _e.ret();
+        }
+
+        // keep the stack aligned for the helper calls, with two scratch slots at [rsp] and [rsp + 8]
+        void emit_prologue() {
+            for (auto r : {rbx, rbp, r12, r13, r14, r15})
+                _e.push(r);
+            _e.adjust_rsp(-24);
+            _e.mov64(ctx, rdi);
+            _e.mov64(nz, reinterpret_cast<uint64_t>(nz_table.data()));
+            _e.load64(rax, ctx, ctx_regs);
+            _e.load8(ra, rax, regs_ac);
+            _e.load8(rx, rax, regs_x);
+            _e.load8(ry, rax, regs_y);
+            _e.load8(rp, rax, regs_sr);
+        }
+
+        // add the cycles of the instructions already executed
+        void flush_cycles() {
+            if (_pending) {
+                _e.add_mem64(ctx, ctx_cycles, static_cast<int32_t>(_pending));
+                _pending = 0;
+            }
+        }
+
+        // add the cycles of the current instruction too, without touching the translation state so that
+        // the code after a side exit still counts them
+        void retire_cycles() {
+            if (_pending + _current)
+                _e.add_mem64(ctx, ctx_cycles, static_cast<int32_t>(_pending + _current));
+            if (_penalty) {
+                _e.load32(rax, rsp, 8);
+                _e.add_mem64(ctx, ctx_cycles, rax);
+            }
+        }
+
+        void exit(uint16_t pc, std::size_t count) {
+            retire_cycles();
+            _e.load64(rax, ctx, ctx_regs);
+            _e.store16(rax, regs_pc, pc);
+            _e.mov(rdx, static_cast<uint32_t>(count));
+            _e.jmp(_epilogue);
+        }
+
+        // pc in eax
+        void exit_dynamic(std::size_t count) {
+            retire_cycles();
+            _e.load64(rdx, ctx, ctx_regs);
+            _e.store16(rdx, regs_pc, rax);
+            _e.mov(rdx, static_cast<uint32_t>(count));
+            _e.jmp(_epilogue);
+        }
+
+        void set_nz(reg value) {
+            _e.and_(rp, static_cast<uint8_t>(~(flag::negative | flag::zero)));
+            _e.load8(rax, nz, value);
+            _e.or_(rp, rax);
+        }
+
+        // carry from eax (0 or 1)
+        void set_carry_from_eax() {
+            _e.and_(rp, static_cast<uint8_t>(~flag::carry));
+            _e.or_(rp, rax);
+        }
+
+        // +1 cycle when base_lo + index crosses a page, kept in the stack slot until the instruction retires
+        void page_penalty(reg index, uint8_t base_lo) {
+            _e.cmp(index, 0xff - base_lo);
+            _e.setcc(cc_a, rax);
+            _e.movzx8(rax, rax);
+            _e.store32(rsp, 8, rax);
+            _penalty = true;
+        }
+
+        // effective address in esi, return false for modes without one
+        bool address(decoded_op const &op) {
+            switch (op.mode) {
+                case address_mode::Zpg:
+                case address_mode::Abs:
+                    _e.mov(rsi, op.addr);
+                    return true;
+                case address_mode::ZpgX:
+                case address_mode::ZpgY:
+                    _e.mov(rsi, op.mode == address_mode::ZpgX ? rx : ry);
+                    _e.add(rsi, op.operand);
+                    _e.and_(rsi, 0xff);
+                    return true;
+                case address_mode::AbsX:
+                case address_mode::AbsY: {
+                    auto index = op.mode == address_mode::AbsX ? rx : ry;
+                    if (op.boundary_hint)
+                        page_penalty(index, op.operand & 0xffu);
+                    _e.mov(rsi, index);
+                    _e.add(rsi, op.operand);
+                    _e.and_(rsi, 0xffff);
+                    return true;
+                }
+                case address_mode::XInd:
+                    _e.mov(rax, rx);
+                    _e.add(rax, op.operand & 0xffu);
+                    _e.and_(rax, 0xff);
+                    _e.load64(rdx, ctx, ctx_ram);
+                    _e.load8(rsi, rdx, rax);
+                    _e.add(rax, 1);
+                    _e.and_(rax, 0xff);
+                    _e.load8(rax, rdx, rax);
+                    _e.shl(rax, 8);
+                    _e.or_(rsi, rax);
+                    return true;
+                case address_mode::IndY:
+                    _e.load64(rdx, ctx, ctx_ram);
+                    _e.load8(rsi, rdx, op.operand & 0xffu);
+                    _e.load8(rax, rdx, (op.operand + 1) & 0xffu);
+                    _e.shl(rax, 8);
+                    _e.or_(rsi, rax);
+                    if (op.boundary_hint) {
+                        _e.mov(rax, rsi);
+                        _e.and_(rax, 0xff);
+                        _e.add(rax, ry);
+                        _e.cmp(rax, 0xff);
+                        _e.setcc(cc_a, rax);
+                        _e.movzx8(rax, rax);
+                        _e.store32(rsp, 8, rax);
+                        _penalty = true;
+                    }
+                    _e.add(rsi, ry);
+                    _e.and_(rsi, 0xffff);
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // operand value in ecx
+        void read(decoded_op const &op) {
+            switch (op.mode) {
+                case address_mode::Imm:
+                    _e.mov(rcx, op.operand & 0xffu);
+                    return;
+                case address_mode::Acc:
+                    _e.mov(rcx, ra);
+                    return;
+                case address_mode::Zpg:
+                case address_mode::Abs:
+                    // the internal ram has no side effect, read it in place
+                    if (op.addr < 0x2000) {
+                        _e.load64(rax, ctx, ctx_ram);
+                        _e.load8(rcx, rax, op.addr & 0x7ffu);
+                        return;
+                    }
+                    break;
+                case address_mode::ZpgX:
+                case address_mode::ZpgY:
+                    address(op);
+                    _e.load64(rax, ctx, ctx_ram);
+                    _e.load8(rcx, rax, rsi);
+                    return;
+                default:
+                    break;
+            }
+
+            address(op);
+            flush_cycles();
+            _e.mov64(rdi, ctx);
+            _e.call(&jit_read);
+            _e.mov(rcx, rax);
+        }
+
+        // store edx at esi, leave the block if the bus asks for it
+        void write() {
+            flush_cycles();
+            _e.mov64(rdi, ctx);
+            _e.call(&jit_write);
+            _e.test(rax, rax);
+            auto stay = _e.jcc(cc_e);
+            exit(_next, _count);
+            _e.bind(stay);
+        }
+
+        void store(decoded_op const &op, reg value) {
+            address(op);
+            _e.mov(rdx, value);
+            write();
+        }
+
+        void push(reg value) {
+            _e.mov(rsi, value);
+            _e.mov64(rdi, ctx);
+            _e.call(&jit_push);
+        }
+
+        void pull() {
+            _e.mov64(rdi, ctx);
+            _e.call(&jit_pull);
+        }
+
+        // read, modify ecx in place, write back. The address is kept in the stack slot across the read.
+        template<typename Fn>
+        void read_modify_write(decoded_op const &op, Fn &&modify) {
+            if (op.mode == address_mode::Acc) {
+                _e.mov(rcx, ra);
+                modify();
+                _e.mov(ra, rcx);
+                return;
+            }
+
+            address(op);
+            _e.store32(rsp, 0, rsi);
+            flush_cycles();
+            _e.mov64(rdi, ctx);
+            _e.call(&jit_read);
+            _e.mov(rcx, rax);
+            modify();
+            _e.mov(rdx, rcx);
+            _e.load32(rsi, rsp, 0);
+            write();
+        }
+
+        void adc() {
+            _e.mov(rax, rp);
+            _e.and_(rax, flag::carry);
+            _e.mov(rdx, ra);
+            _e.add(rdx, rcx);
+            _e.add(rdx, rax);
+            // overflow: the operands have the same sign and the result does not
+            _e.mov(rax, ra);
+            _e.xor_(rax, rcx);
+            _e.not_(rax);
+            _e.mov(rsi, ra);
+            _e.xor_(rsi, rdx);
+            _e.and_(rax, rsi);
+            _e.and_(rax, 0x80);
+            _e.shr(rax, 1);
+            _e.and_(rp, static_cast<uint8_t>(~(flag::carry | flag::overflow)));
+            _e.or_(rp, rax);
+            _e.mov(rax, rdx);
+            _e.shr(rax, 8);
+            _e.or_(rp, rax);
+            _e.mov(ra, rdx);
+            _e.and_(ra, 0xff);
+            set_nz(ra);
+        }
+
+        void compare(reg value) {
+            _e.cmp(value, rcx);
+            _e.setcc(cc_ae, rax);
+            _e.movzx8(rax, rax);
+            set_carry_from_eax();
+            _e.mov(rax, value);
+            _e.sub(rax, rcx);
+            _e.and_(rax, 0xff);
+            _e.mov(rdx, rax);
+            set_nz(rdx);
+        }
+
+        void increment(reg r, int32_t delta) {
+            _e.add(r, delta);
+            _e.and_(r, 0xff);
+            set_nz(r);
+        }
+
+        void transfer(reg dst, reg src) {
+            _e.mov(dst, src);
+            set_nz(dst);
+        }
+
+        void load(decoded_op const &op, reg dst) {
+            read(op);
+            _e.mov(dst, rcx);
+            set_nz(dst);
+        }
+
+        void branch(uint16_t pc, uint16_t target, uint8_t mask, bool set) {
+            _e.test(rp, mask);
+            auto taken = _e.jcc(set ? cc_ne : cc_e);
+            exit(_next, _count);
+            _e.bind(taken);
+            _current += 1 + ((pc & 0xff00u) != (target & 0xff00u));
+            exit(target, _count);
+        }
+
+        // return false when the instruction ends the block
+        bool emit(decoded_op const &op, uint16_t pc) {
+            _current = op.cycles;
+            _penalty = false;
+
+            switch (op.op) {
+                case opcode::LDA:
+                    load(op, ra);
+                    break;
+                case opcode::LDX:
+                    load(op, rx);
+                    break;
+                case opcode::LDY:
+                    load(op, ry);
+                    break;
+                case opcode::STA:
+                    store(op, ra);
+                    break;
+                case opcode::STX:
+                    store(op, rx);
+                    break;
+                case opcode::STY:
+                    store(op, ry);
+                    break;
+                case opcode::TAX:
+                    transfer(rx, ra);
+                    break;
+                case opcode::TAY:
+                    transfer(ry, ra);
+                    break;
+                case opcode::TXA:
+                    transfer(ra, rx);
+                    break;
+                case opcode::TYA:
+                    transfer(ra, ry);
+                    break;
+                case opcode::TSX:
+                    _e.load64(rax, ctx, ctx_regs);
+                    _e.load8(rx, rax, regs_sp);
+                    set_nz(rx);
+                    break;
+                case opcode::TXS:
+                    _e.load64(rax, ctx, ctx_regs);
+                    _e.store8(rax, regs_sp, rx);
+                    break;
+
+                case opcode::PHA:
+                    push(ra);
+                    break;
+                case opcode::PHP:
+                    _e.mov(rcx, rp);
+                    _e.or_(rcx, flag::brk | flag::unused);
+                    push(rcx);
+                    break;
+                case opcode::PLA:
+                    pull();
+                    _e.mov(ra, rax);
+                    set_nz(ra);
+                    break;
+                case opcode::PLP:
+                    pull();
+                    _e.and_(rax, static_cast<uint8_t>(~flag::brk));
+                    _e.or_(rax, flag::unused);
+                    _e.mov(rp, rax);
+                    break;
+
+                case opcode::ADC:
+                    read(op);
+                    adc();
+                    break;
+                case opcode::SBC:
+                    read(op);
+                    _e.xor_(rcx, 0xff);
+                    adc();
+                    break;
+                case opcode::AND:
+                    read(op);
+                    _e.and_(ra, rcx);
+                    set_nz(ra);
+                    break;
+                case opcode::ORA:
+                    read(op);
+                    _e.or_(ra, rcx);
+                    set_nz(ra);
+                    break;
+                case opcode::EOR:
+                    read(op);
+                    _e.xor_(ra, rcx);
+                    set_nz(ra);
+                    break;
+                case opcode::BIT:
+                    read(op);
+                    _e.and_(rp, static_cast<uint8_t>(~(flag::negative | flag::overflow | flag::zero)));
+                    _e.mov(rax, rcx);
+                    _e.and_(rax, flag::negative | flag::overflow);
+                    _e.or_(rp, rax);
+                    _e.test(ra, rcx);
+                    _e.setcc(cc_e, rax);
+                    _e.movzx8(rax, rax);
+                    _e.shl(rax, 1);
+                    _e.or_(rp, rax);
+                    break;
+                case opcode::CMP:
+                    read(op);
+                    compare(ra);
+                    break;
+                case opcode::CPX:
+                    read(op);
+                    compare(rx);
+                    break;
+                case opcode::CPY:
+                    read(op);
+                    compare(ry);
+                    break;
+
+                case opcode::INC:
+                    read_modify_write(op, [this] { increment(rcx, 1); });
+                    break;
+                case opcode::DEC:
+                    read_modify_write(op, [this] { increment(rcx, -1); });
+                    break;
+                case opcode::INX:
+                    increment(rx, 1);
+                    break;
+                case opcode::INY:
+                    increment(ry, 1);
+                    break;
+                case opcode::DEX:
+                    increment(rx, -1);
+                    break;
+                case opcode::DEY:
+                    increment(ry, -1);
+                    break;
+
+                case opcode::ASL:
+                    read_modify_write(op, [this] {
+                        _e.mov(rax, rcx);
+                        _e.shr(rax, 7);
+                        _e.shl(rcx, 1);
+                        _e.and_(rcx, 0xff);
+                        set_carry_from_eax();
+                        set_nz(rcx);
+                    });
+                    break;
+                case opcode::LSR:
+                    read_modify_write(op, [this] {
+                        _e.mov(rax, rcx);
+                        _e.and_(rax, 1);
+                        _e.shr(rcx, 1);
+                        set_carry_from_eax();
+                        set_nz(rcx);
+                    });
+                    break;
+                case opcode::ROL:
+                    read_modify_write(op, [this] {
+                        _e.mov(rdx, rp);
+                        _e.and_(rdx, flag::carry);
+                        _e.mov(rax, rcx);
+                        _e.shr(rax, 7);
+                        _e.shl(rcx, 1);
+                        _e.or_(rcx, rdx);
+                        _e.and_(rcx, 0xff);
+                        set_carry_from_eax();
+                        set_nz(rcx);
+                    });
+                    break;
+                case opcode::ROR:
+                    read_modify_write(op, [this] {
+                        _e.mov(rdx, rp);
+                        _e.and_(rdx, flag::carry);
+                        _e.shl(rdx, 7);
+                        _e.mov(rax, rcx);
+                        _e.and_(rax, 1);
+                        _e.shr(rcx, 1);
+                        _e.or_(rcx, rdx);
+                        set_carry_from_eax();
+                        set_nz(rcx);
+                    });
+                    break;
+
+                case opcode::JMP:
+                    exit(op.addr, _count);
+                    return false;
+                case opcode::JSR: {
+                    uint16_t ret = pc + 2;
+                    _e.mov(rcx, static_cast<uint32_t>(ret >> 8u));
+                    push(rcx);
+                    _e.mov(rcx, static_cast<uint32_t>(ret & 0xffu));
+                    push(rcx);
+                    exit(op.addr, _count);
+                    return false;
+                }
+                case opcode::RTS:
+                    pull();
+                    _e.store32(rsp, 0, rax);
+                    pull();
+                    _e.shl(rax, 8);
+                    _e.load32(rcx, rsp, 0);
+                    _e.or_(rax, rcx);
+                    _e.add(rax, 1);
+                    _e.and_(rax, 0xffff);
+                    exit_dynamic(_count);
+                    return false;
+
+                case opcode::BPL:
+                    branch(_next, op.addr, flag::negative, false);
+                    return false;
+                case opcode::BMI:
+                    branch(_next, op.addr, flag::negative, true);
+                    return false;
+                case opcode::BVC:
+                    branch(_next, op.addr, flag::overflow, false);
+                    return false;
+                case opcode::BVS:
+                    branch(_next, op.addr, flag::overflow, true);
+                    return false;
+                case opcode::BCC:
+                    branch(_next, op.addr, flag::carry, false);
+                    return false;
+                case opcode::BCS:
+                    branch(_next, op.addr, flag::carry, true);
+                    return false;
+                case opcode::BNE:
+                    branch(_next, op.addr, flag::zero, false);
+                    return false;
+                case opcode::BEQ:
+                    branch(_next, op.addr, flag::zero, true);
+                    return false;
+
+                case opcode::CLC:
+                    _e.and_(rp, static_cast<uint8_t>(~flag::carry));
+                    break;
+                case opcode::SEC:
+                    _e.or_(rp, flag::carry);
+                    break;
+                case opcode::CLI:
+                    _e.and_(rp, static_cast<uint8_t>(~flag::irq_disable));
+                    break;
+                case opcode::SEI:
+                    _e.or_(rp, flag::irq_disable);
+                    break;
+                case opcode::CLV:
+                    _e.and_(rp, static_cast<uint8_t>(~flag::overflow));
+                    break;
+                case opcode::CLD:
+                    _e.and_(rp, static_cast<uint8_t>(~flag::decimal));
+                    break;
+                case opcode::SED:
+                    _e.or_(rp, flag::decimal);
+                    break;
+
+                case opcode::NOP:
+                case opcode::BRK:
+                case opcode::RTI:
+                case opcode::ILL:
+                    break;
+            }
+
+            _pending += _current;
+            _current = 0;
+            if (_penalty) {
+                _e.load32(rax, rsp, 8);
+                _e.add_mem64(ctx, ctx_cycles, rax);
+                _penalty = false;
+            }
+            return true;
+        }
+
+        emitter &_e;
+        std::size_t _epilogue{0};
+        std::size_t _entry{0};
+        std::size_t _count{0};
+        uint16_t _next{0};
+        // static cycles of the instructions before the current one not yet added to the context
+        uint32_t _pending{0};
+        uint32_t _current{0};
+        // the current instruction has a dynamic page crossing penalty in the stack slot
+        bool _penalty{false};
+    };
+
+    // executable memory, written with the pages made writable then executable again
+    class code_arena {
+    public:
+        static constexpr std::size_t capacity{8u << 20u};
+
+        code_arena() {
+            auto mem = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem != MAP_FAILED)
+                _base = static_cast<uint8_t *>(mem);
+            _page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        }
+
+        ~code_arena() {
+            if (_base)
+                munmap(_base, capacity);
+        }
+
+        code_arena(code_arena const &) = delete;
+
+        code_arena &operator=(code_arena const &) = delete;
+
+        // nullptr when full
+        uint8_t *install(std::vector<uint8_t> const &code) {
+            auto start = (_used + 15u) & ~std::size_t{15};
+            if (!_base || start + code.size() > capacity)
+                return nullptr;
+
+            auto first = start & ~(_page - 1);
+            auto last = (start + code.size() + _page - 1) & ~(_page - 1);
+            mprotect(_base + first, last - first, PROT_READ | PROT_WRITE);
+            std::memcpy(_base + start, code.data(), code.size());
+            mprotect(_base + first, last - first, PROT_READ | PROT_EXEC);
+            _used = start + code.size();
+            return _base + start;
+        }
+
+        void clear() noexcept {
+            _used = 0;
+        }
+
+    private:
+        uint8_t *_base{nullptr};
+        std::size_t _page{4096};
+        std::size_t _used{0};
+    };
+}
+
+struct nes::cpu::jit_impl {
+private:
+    // a block is translated after this many interpreted runs
+    static constexpr uint32_t hot_threshold{8};
+    static constexpr std::size_t entries{4096};
+
+    struct entry {
+        uint16_t pc{0};
+        uint8_t const *page{nullptr};
+        uint32_t runs{0};
+        bool rejected{false};
+        block_fn fn{nullptr};
+    };
+
+    block_cache *_blocks{nullptr};
+    jit_context _context{};
+    code_arena _arena;
+    std::vector<entry> _entries{entries};
+    uint64_t _translated{0};
+
+    static constexpr std::size_t index(uint16_t pc) noexcept {
+        return (pc ^ (pc >> 12u)) & (entries - 1);
+    }
+
+    block_fn translate(uint16_t pc) {
+        auto const &block = _blocks->lookup(pc);
+        if (!_blocks->valid(block))
+            return nullptr;
+
+        emitter e;
+        translator t(e);
+        if (!t.translate(block))
+            return nullptr;
+
+        auto code = _arena.install(e.code);
+        if (!code) {
+            SPDLOG_DEBUG("jit code arena full, dropping every translation");
+            clear();
+            code = _arena.install(e.code);
+            if (!code)
+                return nullptr;
+        }
+        _translated++;
+        return reinterpret_cast<block_fn>(code + t.entry());
+    }
+
+    void clear() noexcept {
+        _arena.clear();
+        std::fill(_entries.begin(), _entries.end(), entry{});
+    }
+
+    friend jit;
+};
+
+jit::jit(regs &regs, cpu_mem_bus &membus, scheduler &scheduler, block_cache &blocks) : _impl(
+        std::make_unique<jit_impl>()) {
+    _impl->_blocks = &blocks;
+    _impl->_context.r = &regs;
+    _impl->_context.membus = &membus;
+    _impl->_context.clock = &scheduler;
+    _impl->_context.ram = membus.data().data();
+}
+
+jit::~jit() = default;
+
+bool jit::supported() noexcept {
+    return true;
+}
+
+uint32_t jit::run() {
+    auto &impl = *_impl;
+    auto pc = impl._context.r->pc;
+    // prg-rom only, ram code may change under the translation
+    if (pc < 0x8000)
+        return 0;
+
+    auto page = impl._context.membus->read_page(static_cast<uint8_t>(pc >> 8u));
+    auto &e = impl._entries[jit_impl::index(pc)];
+    if (e.pc != pc || e.page != page)
+        e = jit_impl::entry{pc, page};
+
+    if (!e.fn) {
+        if (e.rejected || ++e.runs < jit_impl::hot_threshold)
+            return 0;
+        auto fn = impl.translate(pc);
+        // a full arena clears every entry, this one included
+        e = jit_impl::entry{pc, page, jit_impl::hot_threshold, false, fn};
+        if (!e.fn) {
+            e.rejected = true;
+            return 0;
+        }
+    }
+
+    impl._context.cycles = 0;
+    impl._context.synced = 0;
+    return e.fn(&impl._context);
+}
+
+uint64_t jit::cycles() const noexcept {
+    return _impl->_context.cycles;
+}
+
+uint64_t jit::synced() const noexcept {
+    return _impl->_context.synced;
+}
+
+uint64_t jit::translated_blocks() const noexcept {
+    return _impl->_translated;
+}
+
+void jit::clear() noexcept {
+    _impl->clear();
+}
+
+#else
+
+using namespace nes::cpu;
+
+struct nes::cpu::jit_impl {
+};
+
+jit::jit(regs &, cpu_mem_bus &, scheduler &, block_cache &) {
+}
+
+jit::~jit() = default;
+
+bool jit::supported() noexcept {
+    return false;
+}
+
+uint32_t jit::run() {
+    return 0;
+}
+
+uint64_t jit::cycles() const noexcept {
+    return 0;
+}
+
+uint64_t jit::synced() const noexcept {
+    return 0;
+}
+
+uint64_t jit::translated_blocks() const noexcept {
+    return 0;
+}
+
+void jit::clear() noexcept {
+}
+
+#endif
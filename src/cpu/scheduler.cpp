@@ -0,0 +1,121 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "cpu/scheduler.h"
+
+using namespace nes::cpu;
+
+namespace {
+    constexpr uint64_t never{std::numeric_limits<uint64_t>::max()};
+
+    // first cycle at the end of which the ppu, at ppu_time, has run dots more dots
+    constexpr uint64_t dots_to_cycle(uint64_t ppu_time, uint64_t dots) noexcept {
+        return dots == never ? never : ppu_time + (dots + 2) / 3;
+    }
+}
+
+scheduler::scheduler(cartridge::cartridge &cartridge, ppu::ppu &ppu, apu::apu &apu) : _cartridge(cartridge),
+                                                                                      _ppu(ppu), _apu(apu) {
+    _events.reserve(16);
+}
+
+void scheduler::reset(uint64_t now) {
+    _ppu.reset();
+    _apu.reset();
+    rebase(now);
+}
+
+void scheduler::rebase(uint64_t now) {
+    _now = now;
+    _ppu_time = now;
+    _apu_time = now;
+    _events.clear();
+    _due.fill(never);
+    _deadline = never;
+    _irq_held = false;
+    reschedule_ppu();
+    reschedule_apu();
+}
+
+void scheduler::sync_ppu() {
+    run_ppu();
+    reschedule_ppu();
+}
+
+void scheduler::sync_apu() {
+    run_apu();
+    reschedule_apu();
+}
+
+void scheduler::sync() {
+    sync_ppu();
+    sync_apu();
+}
+
+void scheduler::reschedule_ppu() {
+    schedule(event_source::nmi, dots_to_cycle(_ppu_time, _ppu.dots_to_nmi()));
+    auto dots = _ppu.dots_to_irq();
+    schedule(event_source::mapper_irq, dots == 0 && _irq_held ? never : dots_to_cycle(_ppu_time, dots));
+}
+
+void scheduler::reschedule_apu() {
+    auto cycles = _apu.cycles_to_irq();
+    if (cycles == never || (cycles == 0 && _irq_held))
+        schedule(event_source::apu_irq, never);
+    else
+        schedule(event_source::apu_irq, _apu_time + cycles);
+
+    cycles = _apu.cycles_to_dma();
+    schedule(event_source::dmc_dma, cycles == never ? never : _apu_time + cycles);
+}
+
+void scheduler::schedule(event_source source, uint64_t time) {
+    auto &due = _due[static_cast<std::size_t>(source)];
+    if (due == time)
+        return;
+    due = time;
+    if (time == never)
+        return;
+
+    _events.push_back({time, source});
+    std::ranges::push_heap(_events, std::greater<>{}, &event::time);
+    _deadline = _events.front().time;
+}
+
+interrupts scheduler::poll() {
+    bool ppu = false;
+    bool apu = false;
+    while (!_events.empty() && _events.front().time <= _now) {
+        std::ranges::pop_heap(_events, std::greater<>{}, &event::time);
+        auto e = _events.back();
+        _events.pop_back();
+
+        auto &due = _due[static_cast<std::size_t>(e.source)];
+        if (e.time != due)
+            continue;
+        due = never;
+        (e.source == event_source::apu_irq || e.source == event_source::dmc_dma ? apu : ppu) = true;
+    }
+    _deadline = _events.empty() ? never : _events.front().time;
+
+    interrupts lines{};
+    if (ppu) {
+        run_ppu();
+        lines.nmi = _ppu.poll_nmi();
+    }
+    if (apu)
+        run_apu();
+    lines.irq = _cartridge.board().irq() || _apu.irq();
+    _irq_held = lines.irq;
+
+    if (ppu)
+        reschedule_ppu();
+    if (apu)
+        reschedule_apu();
+    return lines;
+}
@@ -0,0 +1,112 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+#include "core/batch.h"
+#include "core/console.h"
+#include "input/movie.h"
+
+static void usage(char const *name) {
+    fmt::print(stderr, "usage: {} <rom> [--frames N | --cycles N] [--movie file.fm2] [--jit]\n", name);
+}
+
+int main(int ac, char **av) {
+    if (ac < 2) {
+        usage(av[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t frames{600};
+    uint64_t cycles{0};
+    bool jit{false};
+    bool frames_set{false};
+    std::optional<std::filesystem::path> movie_path;
+    for (int i = 2; i < ac; i++) {
+        std::string_view arg{av[i]};
+        if (arg == "--frames" && i + 1 < ac) {
+            frames = std::strtoull(av[++i], nullptr, 10);
+            frames_set = true;
+        } else if (arg == "--cycles" && i + 1 < ac) {
+            cycles = std::strtoull(av[++i], nullptr, 10);
+        } else if (arg == "--movie" && i + 1 < ac) {
+            movie_path = av[++i];
+        } else if (arg == "--jit") {
+            jit = true;
+        } else {
+            usage(av[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::unique_ptr<nes::core::console> console;
+    nes::input::movie movie;
+    try {
+        console = std::make_unique<nes::core::console>(std::filesystem::path(av[1]));
+        if (movie_path)
+            movie = nes::input::movie(*movie_path);
+    } catch (nes::cartridge::rom_error const &e) {
+        spdlog::error("{}", e.what());
+        return EXIT_FAILURE;
+    } catch (nes::input::movie_error const &e) {
+        spdlog::error("{}", e.what());
+        return EXIT_FAILURE;
+    }
+
+    // a movie plays to its end unless told otherwise, the buttons are released past it
+    if (movie_path && !frames_set)
+        frames = movie.size();
+    auto &cpu = console->cpu();
+    if (jit && !cpu.enable_jit(true))
+        spdlog::warn("the jit is not supported on this build, interpreting");
+
+    using clock = std::chrono::steady_clock;
+    std::chrono::nanoseconds slowest{0};
+    std::chrono::nanoseconds fastest{std::chrono::nanoseconds::max()};
+
+    // frames run from vblank to vblank, --cycles runs whole frames until the clock reaches its count
+    auto start = clock::now();
+    uint64_t frame = 0;
+    for (; cycles != 0 ? cpu.cycles() < cycles : frame < frames; frame++) {
+        auto frame_start = clock::now();
+        console->set_input(frame < movie.size() ? movie[frame] : nes::input::movie_frame{});
+        console->run_frame();
+        auto elapsed = clock::now() - frame_start;
+
+        slowest = std::max(slowest, elapsed);
+        fastest = std::min(fastest, elapsed);
+    }
+    std::chrono::duration<double> total = clock::now() - start;
+    frames = frame;
+
+    auto seconds = total.count();
+    auto emulated = static_cast<double>(cpu.cycles()) / nes::cpu::ntsc_clock_hz;
+    fmt::print("rom          {}\n", console->cartridge().file().string());
+    fmt::print("frames       {}\n", frames);
+    fmt::print("cycles       {}\n", cpu.cycles());
+    fmt::print("instructions {}\n", cpu.instructions());
+    if (movie_path)
+        fmt::print("movie        {} frames, last frame {:016x}\n", movie.size(),
+                   nes::core::hash_frame(console->ppu().framebuffer()));
+    fmt::print("block cache  {} hits, {} misses\n", cpu.blocks().hits(), cpu.blocks().misses());
+    if (cpu.jit_enabled())
+        fmt::print("jit          {} blocks translated\n", cpu.translated_blocks());
+    fmt::print("wall time    {:.3f} s\n", seconds);
+    fmt::print("frame time   min {:.3f} ms, avg {:.3f} ms, max {:.3f} ms\n",
+               std::chrono::duration<double, std::milli>(fastest).count(),
+               seconds * 1000.0 / static_cast<double>(std::max<uint64_t>(frames, 1)),
+               std::chrono::duration<double, std::milli>(slowest).count());
+    fmt::print("speed        {:.1f} fps, {:.2f} MIPS, {:.1f}x real time\n",
+               static_cast<double>(frames) / seconds,
+               static_cast<double>(cpu.instructions()) / seconds / 1e6,
+               emulated / seconds);
+
+    return EXIT_SUCCESS;
+}
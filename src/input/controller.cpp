@@ -0,0 +1,42 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include "input/controller.h"
+
+using namespace nes::input;
+
+void controllers::set_buttons(unsigned port, uint8_t buttons) noexcept {
+    _s.buttons[port & 0x01u] = buttons;
+    if (_s.strobe)
+        _s.shift[port & 0x01u] = buttons;
+}
+
+uint8_t controllers::buttons(unsigned port) const noexcept {
+    return _s.buttons[port & 0x01u];
+}
+
+uint8_t controllers::fetch_register(uint16_t addr) noexcept {
+    auto port = addr & 0x01u;
+    if (_s.strobe)
+        _s.shift[port] = _s.buttons[port];
+
+    uint8_t bit = _s.shift[port] & 0x01u;
+    _s.shift[port] = static_cast<uint8_t>((_s.shift[port] >> 1u) | 0x80u);
+    // the upper bits are what was last on the data bus, the high byte of the address
+    return 0x40u | bit;
+}
+
+void controllers::store_register(uint8_t data) noexcept {
+    _s.strobe = data & 0x01u;
+    if (_s.strobe)
+        _s.shift = _s.buttons;
+}
+
+void controllers::save(controller_state &state) const noexcept {
+    state = _s;
+}
+
+void controllers::load(controller_state const &state) noexcept {
+    _s = state;
+}
@@ -0,0 +1,87 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <charconv>
+#include <fstream>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include "input/movie.h"
+
+using namespace nes::input;
+
+namespace {
+    // fm2 writes the buttons from the highest bit down
+    constexpr std::string_view button_names{"RLDUTSBA"};
+
+    // soft and hard reset commands, both reset the console here
+    constexpr unsigned reset_commands{0x03};
+
+    uint8_t parse_buttons(std::string_view field) noexcept {
+        uint8_t buttons{0};
+        for (std::size_t i = 0; i < field.size() && i < button_names.size(); i++)
+            if (field[i] != ' ' && field[i] != '.')
+                buttons |= static_cast<uint8_t>(0x80u >> i);
+        return buttons;
+    }
+
+    std::string format_buttons(uint8_t buttons) {
+        std::string field(button_names.size(), '.');
+        for (std::size_t i = 0; i < button_names.size(); i++)
+            if (buttons & (0x80u >> i))
+                field[i] = button_names[i];
+        return field;
+    }
+}
+
+movie::movie(std::filesystem::path const &path) {
+    std::ifstream in(path);
+    if (!in)
+        throw movie_error(fmt::format("cannot read {}", path.string()));
+
+    std::size_t number{0};
+    for (std::string line; std::getline(in, line);) {
+        number++;
+        std::string_view view{line};
+        if (!view.empty() && view.back() == '\r')
+            view.remove_suffix(1);
+
+        if (!view.starts_with('|')) {
+            if (view.starts_with("romFilename "))
+                _rom_name = view.substr(12);
+            continue;
+        }
+
+        // |commands|port0|port1|port2|, the ports may be missing
+        std::array<std::string_view, 3> fields{};
+        view.remove_prefix(1);
+        for (auto &field : fields) {
+            auto end = view.find('|');
+            if (end == std::string_view::npos)
+                break;
+            field = view.substr(0, end);
+            view.remove_prefix(end + 1);
+        }
+
+        unsigned commands{0};
+        auto [end, error] = std::from_chars(fields[0].data(), fields[0].data() + fields[0].size(), commands);
+        if (error != std::errc() || end != fields[0].data() + fields[0].size())
+            throw movie_error(fmt::format("{}:{}: bad commands field", path.string(), number));
+
+        _frames.push_back({{parse_buttons(fields[1]), parse_buttons(fields[2])}, (commands & reset_commands) != 0});
+    }
+}
+
+void movie::save(std::filesystem::path const &path) const {
+    std::ofstream out(path, std::ios::trunc);
+    out << "version 3\nemuVersion 0\nrerecordCount 0\npalFlag 0\n";
+    out << "romFilename " << _rom_name << "\n";
+    out << "fourscore 0\nport0 1\nport1 1\nport2 0\n";
+    for (auto const &frame : _frames)
+        out << '|' << (frame.reset ? 1 : 0) << '|' << format_buttons(frame.buttons[0]) << '|'
+            << format_buttons(frame.buttons[1]) << "||\n";
+    if (!out)
+        throw movie_error(fmt::format("cannot write {}", path.string()));
+}
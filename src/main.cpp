@@ -7,41 +7,85 @@
 
 #include <spdlog/spdlog.h>
 
+#include <SFML/Audio/SoundStream.hpp>
 #include <SFML/Graphics/RenderWindow.hpp>
 #include <SFML/System/Clock.hpp>
 #include <SFML/Window/Event.hpp>
-#include <SFML/Graphics/CircleShape.hpp>
+#include <SFML/Graphics/Sprite.hpp>
+#include <SFML/Graphics/Texture.hpp>
+
+#include "apu/apu.h"
+#include "cartridge/rom.h"
+#include "core/emulator.h"
+#include "input/controller.h"
+#include "ppu/palette.h"
+#include "ppu/ppu.h"
+
+// the first controller on the keyboard: arrows, X for A, Z for B, Return for start and right shift for select
+static uint8_t keyboard_buttons() {
+    using key = sf::Keyboard;
+    namespace button = nes::input::button;
+    uint8_t buttons{0};
+    buttons |= key::isKeyPressed(key::X) ? button::a : 0;
+    buttons |= key::isKeyPressed(key::Z) ? button::b : 0;
+    buttons |= key::isKeyPressed(key::RShift) ? button::select : 0;
+    buttons |= key::isKeyPressed(key::Return) ? button::start : 0;
+    buttons |= key::isKeyPressed(key::Up) ? button::up : 0;
+    buttons |= key::isKeyPressed(key::Down) ? button::down : 0;
+    buttons |= key::isKeyPressed(key::Left) ? button::left : 0;
+    buttons |= key::isKeyPressed(key::Right) ? button::right : 0;
+    return buttons;
+}
+
+// plays the samples of the emulation thread, silence when it has none ready
+class audio_stream : public sf::SoundStream {
+public:
+    explicit audio_stream(nes::core::emulator &emulator) : _emulator(emulator) {
+        initialize(1, nes::apu::sample_rate);
+    }
+
+private:
+    bool onGetData(Chunk &data) override {
+        auto count = _emulator.read_audio(_samples);
+        std::fill(_samples.begin() + static_cast<std::ptrdiff_t>(count), _samples.end(), 0);
+        data.samples = _samples.data();
+        data.sampleCount = _samples.size();
+        return true;
+    }
 
-#include "memory/block.h"
-#include "cpu/cpu_mem_bus.h"
-#include "cpu/decoder.h"
-#include "cpu/regs.h"
-#include "cartridge/cartridge.h"
+    void onSeek(sf::Time) override {
+    }
 
+    nes::core::emulator &_emulator;
+    std::array<sf::Int16, 1024> _samples{};
+};
 
 int main(int ac, char **av) {
-    auto cartridge = std::make_shared<nes::cartridge::cartridge>(std::move(std::filesystem::path(av[1])));
-    auto regs = std::make_shared<nes::cpu::regs>();
-    auto membus = std::make_shared<nes::cpu::cpu_mem_bus>(cartridge);
-    auto decoder = nes::cpu::decoder();
-    regs->pc = membus->fetch_u16(0xfffc);
-    regs->sr = 0x20;
-    regs->sp = 0xfd;
+    auto rom = std::make_shared<nes::cartridge::rom const>(std::filesystem::path(av[1]));
+    // the console runs on its own thread, this one only draws what it publishes
+    auto emulator = nes::core::emulator(rom);
 
     sf::RenderWindow window(sf::VideoMode(1600, 800), "ImGui + SFML = <3");
     window.setFramerateLimit(60);
     ImGui::SFML::Init(window);
 
-    sf::CircleShape shape(100.f);
-    shape.setFillColor(sf::Color::Green);
+    std::vector<sf::Uint8> pixels(nes::ppu::width * nes::ppu::height * 4);
+    sf::Texture screen_texture;
+    screen_texture.create(nes::ppu::width, nes::ppu::height);
+    sf::Sprite screen(screen_texture);
+    screen.setScale(3.f, 3.f);
 
     sf::Clock deltaClock;
     bool show_debug{true};
     static MemoryEditor mem_edit;
+    mem_edit.ReadOnly = true;
     mem_edit.GotoAddrAndHighlight(0x200, 0x300);
+    static MemoryEditor ram_edit;
+    ram_edit.ReadOnly = true;
 
-    auto op = decoder.decode(regs->pc, regs, membus);
-
+    emulator.start();
+    audio_stream audio(emulator);
+    audio.play();
     while (window.isOpen()) {
         sf::Event event;
         while (window.pollEvent(event)) {
@@ -53,56 +97,94 @@ int main(int ac, char **av) {
 
             if (event.type == sf::Event::KeyPressed) {
                 switch (event.key.code) {
-                    case sf::Keyboard::Right:
-                        op = decoder.decode(regs->pc, regs, membus);
-                        regs->pc += op.bytes;
+                    case sf::Keyboard::N:
+                        emulator.send(nes::core::command::step);
+                        break;
+                    case sf::Keyboard::Space:
+                        emulator.send(nes::core::command::toggle_running);
                         break;
                     case sf::Keyboard::H:
                         show_debug = !show_debug;
+                        emulator.enable_snapshots(show_debug);
+                        break;
+                    case sf::Keyboard::T:
+                        emulator.send(nes::core::command::toggle_trace);
+                        break;
+                    case sf::Keyboard::D:
+                        emulator.send(nes::core::command::save_trace);
+                        break;
+                    case sf::Keyboard::Backspace:
+                        emulator.send(nes::core::command::rewind_start);
+                        break;
+                    case sf::Keyboard::R:
+                        emulator.send(nes::core::command::toggle_recording);
                         break;
                     default:
                         break;
                 }
             }
+
+            // rewind while the key is held
+            if (event.type == sf::Event::KeyReleased && event.key.code == sf::Keyboard::Backspace)
+                emulator.send(nes::core::command::rewind_stop);
         }
 
+        emulator.set_buttons(window.hasFocus() ? keyboard_buttons() : 0);
+
+        if (emulator.poll_frame()) {
+            auto const &framebuffer = emulator.current_frame().pixels;
+            for (std::size_t i = 0; i < framebuffer.size(); i++) {
+                auto color = nes::ppu::ntsc_palette[framebuffer[i] & 0x3fu];
+                pixels[i * 4] = color.r;
+                pixels[i * 4 + 1] = color.g;
+                pixels[i * 4 + 2] = color.b;
+                pixels[i * 4 + 3] = 0xff;
+            }
+            screen_texture.update(pixels.data());
+        }
 
         ImGui::SFML::Update(window, deltaClock.restart());
 
         if (show_debug) {
+            emulator.poll_snapshot();
+            auto const &snapshot = emulator.snapshot();
+            auto const &regs = snapshot.regs;
 
-            mem_edit.DrawWindow("Cartridge", const_cast<uint8_t *>(cartridge->data().data()), cartridge->data().size());
+            // the rom image is shared with the core thread, the editor only displays it
+            mem_edit.DrawWindow("PRG-ROM", const_cast<uint8_t *>(rom->prg().data()), rom->prg().size());
+            ram_edit.DrawWindow("RAM", const_cast<uint8_t *>(snapshot.ram.data()), snapshot.ram.size());
 
             ImGui::Begin("Registers");
-            ImGui::LabelText("PC", "%s", fmt::format("{:#06x} => {:#018b}", regs->pc, regs->pc).c_str());
-            ImGui::LabelText("AC", "%s", fmt::format("{:#06x} => {:#018b}", regs->ac, regs->ac).c_str());
-            ImGui::LabelText("X", "%s", fmt::format("{:#06x} => {:#018b}", regs->x, regs->x).c_str());
-            ImGui::LabelText("Y", "%s", fmt::format("{:#06x} => {:#018b}", regs->y, regs->y).c_str());
-            ImGui::LabelText("SR", "%s", fmt::format("{:#06x} => {:#018b}", regs->sr, regs->sr).c_str());
-            ImGui::LabelText("SP", "%s", fmt::format("{:#06x} => {:#018b}", regs->sp, regs->sp).c_str());
+            ImGui::LabelText("PC", "%s", fmt::format("{:#06x} => {:#018b}", regs.pc, regs.pc).c_str());
+            ImGui::LabelText("AC", "%s", fmt::format("{:#06x} => {:#018b}", regs.ac, regs.ac).c_str());
+            ImGui::LabelText("X", "%s", fmt::format("{:#06x} => {:#018b}", regs.x, regs.x).c_str());
+            ImGui::LabelText("Y", "%s", fmt::format("{:#06x} => {:#018b}", regs.y, regs.y).c_str());
+            ImGui::LabelText("SR", "%s", fmt::format("{:#06x} => {:#018b}", regs.sr, regs.sr).c_str());
+            ImGui::LabelText("SP", "%s", fmt::format("{:#06x} => {:#018b}", regs.sp, regs.sp).c_str());
+            ImGui::LabelText("cycles", "%s", fmt::format("{}", snapshot.cycles).c_str());
+            ImGui::LabelText("state", "%s", fmt::format("{}{}{}{}", snapshot.running ? "running" : "paused",
+                                                        snapshot.tracing ? ", tracing" : "",
+                                                        snapshot.rewinding ? ", rewinding" : "",
+                                                        snapshot.recording ? ", recording" : "").c_str());
+            ImGui::LabelText("history", "%s", fmt::format("{} frames", snapshot.history).c_str());
             ImGui::End();
 
             ImGui::Begin("Code");
-            auto decode_instr = decoder.decode(5, regs->pc, regs, membus);
-            auto pc = regs->pc;
-            for (int i = 0; i < decode_instr.size(); i++) {
-                ImGui::LabelText("PC", "%s", fmt::format("{:#06x} => | {:#04x} {:#04x} {:#04x} {:#04x}| => {}",
-                                                         pc,
-                                                         membus->fetch_u8(pc),
-                                                         membus->fetch_u8(pc + 1),
-                                                         membus->fetch_u8(pc + 2),
-                                                         membus->fetch_u8(pc + 3),
-                                                         decode_instr[i]).c_str());
-                pc += decode_instr[i].bytes;
+            auto pc = regs.pc;
+            for (auto const &op : std::span(snapshot.listing).first(snapshot.listed)) {
+                ImGui::LabelText("PC", "%s", fmt::format("{:#06x} => {}", pc, op).c_str());
+                pc += op.bytes;
             }
             ImGui::End();
         }
 
         window.clear();
-        window.draw(shape);
+        window.draw(screen);
         ImGui::SFML::Render(window);
         window.display();
     }
+    audio.stop();
+    emulator.stop();
 
     ImGui::SFML::Shutdown();
 
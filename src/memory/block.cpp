@@ -26,36 +26,37 @@ block::block(std::vector<uint8_t> vec) : _impl(std::make_unique<block_impl>()) {
     _impl->_data = std::move(vec);
 }
 
+// out of the block, reads return 0 and stores are dropped
 uint8_t block::fetch_u8(std::uint16_t addr) const {
-    if (addr > _impl->_data.size())
-        ;//TODO
+    if (addr >= _impl->_data.size())
+        return 0;
 
     return _impl->_data[addr];
 }
 
 uint16_t block::fetch_u16(std::uint16_t addr) const {
-    if ((addr + 1) > _impl->_data.size())
-    ;//TODO
+    if (addr + 1u >= _impl->_data.size())
+        return 0;
 
     return _impl->_data[addr] + (_impl->_data[addr + 1] << 8u);
 }
 
 void block::store(std::uint16_t addr, std::uint8_t data) {
-    if (addr > _impl->_data.size())
-        //TODO;
+    if (addr >= _impl->_data.size())
+        return;
 
     _impl->_data[addr] = data;
 }
 
 void block::store(std::uint16_t addr, std::uint16_t data) {
-    if (addr > _impl->_data.size() + 1)
-        //TODO;
+    if (addr + 1u >= _impl->_data.size())
+        return;
 
     _impl->_data[addr] = data & 0x00ffu;
     _impl->_data[addr + 1] = (data & 0xff00u) >> 8u;
 }
 
-std::vector<uint8_t> const &block::data() const {
+std::span<uint8_t const> block::data() const {
     return _impl->_data;
 }
 
@@ -0,0 +1,46 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+
+#include "ppu/chr_cache.h"
+
+using namespace nes::ppu;
+
+chr_cache::chr_cache(pixel_kernels const &kernels) noexcept: _kernels(kernels) {
+    clear();
+}
+
+void chr_cache::sync(cartridge::mapper const &board) noexcept {
+    for (uint8_t slot = 0; slot < _banks.size(); slot++) {
+        auto bank = board.chr_bank(slot);
+        if (bank == _banks[slot])
+            continue;
+        _banks[slot] = bank;
+        std::fill_n(_dirty.begin() + slot * tiles_per_slot, tiles_per_slot, true);
+    }
+}
+
+void chr_cache::invalidate(cartridge::mapper const &board, uint16_t addr) noexcept {
+    auto written = board.chr_bank(static_cast<uint8_t>(addr >> 10u)) + (addr & 0x3ffu);
+    for (unsigned slot = 0; slot < _banks.size(); slot++) {
+        auto bank = _banks[slot];
+        if (bank && written >= bank && written < bank + 0x400)
+            _dirty[slot * tiles_per_slot + (written - bank) / 16] = true;
+    }
+}
+
+void chr_cache::clear() noexcept {
+    _banks.fill(nullptr);
+    _dirty.fill(true);
+}
+
+void chr_cache::decode(unsigned tile) noexcept {
+    static constexpr std::array<uint8_t, 8> no_palette{};
+    auto planes = _banks[tile / tiles_per_slot] + (tile % tiles_per_slot) * 16;
+    // the 8 rows of a tile are 8 one-row "tiles" for the kernel
+    _kernels.decode_tiles(planes, planes + 8, no_palette.data(), 8,
+                          reinterpret_cast<uint8_t *>(&_rows[tile * 8]));
+    _dirty[tile] = false;
+}
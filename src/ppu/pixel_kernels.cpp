@@ -0,0 +1,239 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include "ppu/pixel_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NES_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace nes::ppu;
+
+namespace {
+    // a byte repeated over the 8 bytes of a 64 bits word, one tile row per word
+    constexpr uint64_t broadcast{0x0101010101010101ull};
+    // lane i of a tile row tests bit 7 - i of the bitplane byte
+    constexpr uint64_t plane_bits{0x0102040810204080ull};
+
+    void decode_tiles_scalar(uint8_t const *lo, uint8_t const *hi, uint8_t const *palette, std::size_t tiles,
+                             uint8_t *out) {
+        for (std::size_t tile = 0; tile < tiles; tile++) {
+            for (int bit = 7; bit >= 0; bit--) {
+                uint8_t color = ((lo[tile] >> bit) & 0x01u) | (((hi[tile] >> bit) & 0x01u) << 1u);
+                *out++ = color ? (palette[tile] | color) : 0;
+            }
+        }
+    }
+
+    void compose_scalar(uint8_t const *background, uint8_t const *sprites, uint8_t const *palette, uint8_t gray,
+                        std::size_t count, uint8_t *out) {
+        for (std::size_t x = 0; x < count; x++) {
+            uint8_t bg = background[x];
+            uint8_t sp = sprites[x];
+            bool bg_opaque = bg & 0x03u;
+            bool sp_opaque = sp & 0x03u;
+
+            uint8_t color;
+            if (sp_opaque && (!bg_opaque || !(sp & 0x40u)))
+                color = sp & 0x1fu;
+            else
+                color = bg_opaque ? bg : 0;
+            out[x] = palette[color] & gray;
+        }
+    }
+
+#ifdef NES_X86_KERNELS
+    // two tiles per iteration: broadcast each bitplane byte over its 8 lanes, test one bit per lane
+    __attribute__((target("ssse3")))
+    void decode_tiles_ssse3(uint8_t const *lo, uint8_t const *hi, uint8_t const *palette, std::size_t tiles,
+                            uint8_t *out) {
+        auto const bits = _mm_set1_epi64x(static_cast<long long>(plane_bits));
+        auto const one = _mm_set1_epi8(1);
+        auto const two = _mm_set1_epi8(2);
+        auto const zero = _mm_setzero_si128();
+
+        std::size_t tile = 0;
+        for (; tile + 2 <= tiles; tile += 2) {
+            auto lo_v = _mm_set_epi64x(static_cast<long long>(lo[tile + 1] * broadcast),
+                                       static_cast<long long>(lo[tile] * broadcast));
+            auto hi_v = _mm_set_epi64x(static_cast<long long>(hi[tile + 1] * broadcast),
+                                       static_cast<long long>(hi[tile] * broadcast));
+            auto pal_v = _mm_set_epi64x(static_cast<long long>(palette[tile + 1] * broadcast),
+                                        static_cast<long long>(palette[tile] * broadcast));
+
+            auto color = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lo_v, bits), bits), one),
+                                      _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(hi_v, bits), bits), two));
+            auto opaque_pal = _mm_andnot_si128(_mm_cmpeq_epi8(color, zero), pal_v);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + tile * 8), _mm_or_si128(color, opaque_pal));
+        }
+
+        decode_tiles_scalar(lo + tile, hi + tile, palette + tile, tiles - tile, out + tile * 8);
+    }
+
+    // 16 pixels per iteration, the 32 entries palette lookup is two pshufb selected by bit 4 of the index
+    __attribute__((target("ssse3")))
+    void compose_ssse3(uint8_t const *background, uint8_t const *sprites, uint8_t const *palette, uint8_t gray,
+                       std::size_t count, uint8_t *out) {
+        auto const pal_lo = _mm_loadu_si128(reinterpret_cast<__m128i const *>(palette));
+        auto const pal_hi = _mm_loadu_si128(reinterpret_cast<__m128i const *>(palette + 16));
+        auto const gray_v = _mm_set1_epi8(static_cast<char>(gray));
+        auto const color_mask = _mm_set1_epi8(0x03);
+        auto const behind = _mm_set1_epi8(0x40);
+        auto const index_mask = _mm_set1_epi8(0x1f);
+        auto const high_half = _mm_set1_epi8(0x10);
+        auto const zero = _mm_setzero_si128();
+
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto bg = _mm_loadu_si128(reinterpret_cast<__m128i const *>(background + x));
+            auto sp = _mm_loadu_si128(reinterpret_cast<__m128i const *>(sprites + x));
+
+            auto bg_clear = _mm_cmpeq_epi8(_mm_and_si128(bg, color_mask), zero);
+            auto sp_clear = _mm_cmpeq_epi8(_mm_and_si128(sp, color_mask), zero);
+            auto sp_behind = _mm_cmpeq_epi8(_mm_and_si128(sp, behind), behind);
+            auto sp_hidden = _mm_or_si128(sp_clear, _mm_andnot_si128(bg_clear, sp_behind));
+
+            auto index = _mm_or_si128(_mm_andnot_si128(sp_hidden, _mm_and_si128(sp, index_mask)),
+                                      _mm_and_si128(sp_hidden, _mm_andnot_si128(bg_clear, bg)));
+            auto upper = _mm_cmpeq_epi8(_mm_and_si128(index, high_half), high_half);
+            auto color = _mm_or_si128(_mm_andnot_si128(upper, _mm_shuffle_epi8(pal_lo, index)),
+                                      _mm_and_si128(upper, _mm_shuffle_epi8(pal_hi, index)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_and_si128(color, gray_v));
+        }
+
+        compose_scalar(background + x, sprites + x, palette, gray, count - x, out + x);
+    }
+
+    // four consecutive bytes, each one repeated over a 64 bits lane
+    __attribute__((target("avx2")))
+    __m256i rows(uint8_t const *bytes) {
+        return _mm256_set_epi64x(static_cast<long long>(bytes[3] * broadcast),
+                                 static_cast<long long>(bytes[2] * broadcast),
+                                 static_cast<long long>(bytes[1] * broadcast),
+                                 static_cast<long long>(bytes[0] * broadcast));
+    }
+
+    __attribute__((target("avx2")))
+    void decode_tiles_avx2(uint8_t const *lo, uint8_t const *hi, uint8_t const *palette, std::size_t tiles,
+                           uint8_t *out) {
+        auto const bits = _mm256_set1_epi64x(static_cast<long long>(plane_bits));
+        auto const one = _mm256_set1_epi8(1);
+        auto const two = _mm256_set1_epi8(2);
+        auto const zero = _mm256_setzero_si256();
+
+        std::size_t tile = 0;
+        for (; tile + 4 <= tiles; tile += 4) {
+            auto lo_v = rows(lo + tile);
+            auto hi_v = rows(hi + tile);
+            auto pal_v = rows(palette + tile);
+
+            auto color = _mm256_or_si256(
+                    _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(lo_v, bits), bits), one),
+                    _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(hi_v, bits), bits), two));
+            auto opaque_pal = _mm256_andnot_si256(_mm256_cmpeq_epi8(color, zero), pal_v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + tile * 8), _mm256_or_si256(color, opaque_pal));
+        }
+
+        decode_tiles_ssse3(lo + tile, hi + tile, palette + tile, tiles - tile, out + tile * 8);
+    }
+
+    // vpshufb works within 128 bits lanes, so both palette halves are broadcast to the two lanes
+    __attribute__((target("avx2")))
+    void compose_avx2(uint8_t const *background, uint8_t const *sprites, uint8_t const *palette, uint8_t gray,
+                      std::size_t count, uint8_t *out) {
+        auto const pal_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(palette)));
+        auto const pal_hi = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(palette + 16)));
+        auto const gray_v = _mm256_set1_epi8(static_cast<char>(gray));
+        auto const color_mask = _mm256_set1_epi8(0x03);
+        auto const behind = _mm256_set1_epi8(0x40);
+        auto const index_mask = _mm256_set1_epi8(0x1f);
+        auto const high_half = _mm256_set1_epi8(0x10);
+        auto const zero = _mm256_setzero_si256();
+
+        std::size_t x = 0;
+        for (; x + 32 <= count; x += 32) {
+            auto bg = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(background + x));
+            auto sp = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(sprites + x));
+
+            auto bg_clear = _mm256_cmpeq_epi8(_mm256_and_si256(bg, color_mask), zero);
+            auto sp_clear = _mm256_cmpeq_epi8(_mm256_and_si256(sp, color_mask), zero);
+            auto sp_behind = _mm256_cmpeq_epi8(_mm256_and_si256(sp, behind), behind);
+            auto sp_hidden = _mm256_or_si256(sp_clear, _mm256_andnot_si256(bg_clear, sp_behind));
+
+            auto index = _mm256_or_si256(_mm256_andnot_si256(sp_hidden, _mm256_and_si256(sp, index_mask)),
+                                         _mm256_and_si256(sp_hidden, _mm256_andnot_si256(bg_clear, bg)));
+            auto upper = _mm256_cmpeq_epi8(_mm256_and_si256(index, high_half), high_half);
+            auto color = _mm256_blendv_epi8(_mm256_shuffle_epi8(pal_lo, index),
+                                            _mm256_shuffle_epi8(pal_hi, index), upper);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x), _mm256_and_si256(color, gray_v));
+        }
+
+        compose_ssse3(background + x, sprites + x, palette, gray, count - x, out + x);
+    }
+#endif
+
+    constexpr pixel_kernels scalar_kernels{decode_tiles_scalar, compose_scalar};
+#ifdef NES_X86_KERNELS
+    constexpr pixel_kernels ssse3_kernels{decode_tiles_ssse3, compose_ssse3};
+    constexpr pixel_kernels avx2_kernels{decode_tiles_avx2, compose_avx2};
+#endif
+}
+
+std::string_view nes::ppu::simd_level2string(simd_level level) {
+    switch (level) {
+        case simd_level::scalar:
+            return "scalar";
+        case simd_level::ssse3:
+            return "ssse3";
+        case simd_level::avx2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+bool nes::ppu::simd_supported(simd_level level) noexcept {
+    switch (level) {
+        case simd_level::scalar:
+            return true;
+#ifdef NES_X86_KERNELS
+        case simd_level::ssse3:
+            return __builtin_cpu_supports("ssse3");
+        case simd_level::avx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+simd_level nes::ppu::detect_simd() noexcept {
+    static simd_level const level = [] {
+        if (simd_supported(simd_level::avx2))
+            return simd_level::avx2;
+        if (simd_supported(simd_level::ssse3))
+            return simd_level::ssse3;
+        return simd_level::scalar;
+    }();
+    return level;
+}
+
+pixel_kernels const &nes::ppu::kernels_for(simd_level level) noexcept {
+    switch (level) {
+#ifdef NES_X86_KERNELS
+        case simd_level::ssse3:
+            return ssse3_kernels;
+        case simd_level::avx2:
+            return avx2_kernels;
+#endif
+        default:
+            return scalar_kernels;
+    }
+}
+
+pixel_kernels const &nes::ppu::active_kernels() noexcept {
+    static pixel_kernels const &kernels = kernels_for(detect_simd());
+    return kernels;
+}
@@ -0,0 +1,579 @@
+//
+// Created by syl on 12/11/2020.
+//
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "ppu/chr_cache.h"
+#include "ppu/pixel_kernels.h"
+#include "ppu/ppu.h"
+
+using namespace nes::ppu;
+
+namespace {
+    namespace ctrl {
+        constexpr uint8_t increment_32{0x04};
+        constexpr uint8_t sprite_table{0x08};
+        constexpr uint8_t background_table{0x10};
+        constexpr uint8_t sprite_16{0x20};
+        constexpr uint8_t nmi{0x80};
+    }
+
+    namespace mask {
+        constexpr uint8_t grayscale{0x01};
+        constexpr uint8_t background_left{0x02};
+        constexpr uint8_t sprites_left{0x04};
+        constexpr uint8_t background{0x08};
+        constexpr uint8_t sprites{0x10};
+    }
+
+    namespace status {
+        constexpr uint8_t overflow{0x20};
+        constexpr uint8_t sprite0_hit{0x40};
+        constexpr uint8_t vblank{0x80};
+    }
+
+    constexpr int vblank_scanline{241};
+    constexpr int prerender_scanline{261};
+
+    // low bit of every byte set where the 2 bits color of that pixel is not 0
+    constexpr uint64_t opaque_pixels(uint64_t row) noexcept {
+        return (row | (row >> 1u)) & 0x0101010101010101ull;
+    }
+}
+
+struct nes::ppu::ppu_impl {
+private:
+    cartridge::cartridge *_cartridge{nullptr};
+    pixel_kernels const &_kernels{active_kernels()};
+    chr_cache _chr_cache{_kernels};
+
+    uint8_t _ctrl{0};
+    uint8_t _mask{0};
+    uint8_t _status{0};
+    uint8_t _oam_addr{0};
+    uint8_t _read_buffer{0};
+    uint8_t _open_bus{0};
+
+    // loopy registers: current and temporary vram address, fine x scroll, write toggle
+    uint16_t _v{0};
+    uint16_t _t{0};
+    uint8_t _x{0};
+    bool _w{false};
+
+    int _scanline{0};
+    int _dot{0};
+    int _sprite0_dot{-1};
+    uint64_t _frame{0};
+    bool _nmi_edge{false};
+
+    std::array<uint8_t, 0x1000> _vram{};
+    std::array<uint8_t, 0x20> _palette{};
+    std::array<uint8_t, 0x100> _oam{};
+    std::array<uint8_t, width * height> _framebuffer{};
+
+    [[nodiscard]] bool rendering() const noexcept {
+        return _mask & (mask::background | mask::sprites);
+    }
+
+    [[nodiscard]] uint16_t nametable_addr(uint16_t addr) const noexcept {
+        auto table = (addr >> 10u) & 0x03u;
+        switch (_cartridge->nametable_mirroring()) {
+            case cartridge::mirroring_mode::horizontal:
+                table >>= 1u;
+                break;
+            case cartridge::mirroring_mode::vertical:
+                table &= 0x01u;
+                break;
+            case cartridge::mirroring_mode::single_screen_lo:
+                table = 0;
+                break;
+            case cartridge::mirroring_mode::single_screen_hi:
+                table = 1;
+                break;
+            case cartridge::mirroring_mode::four_screen:
+                break;
+        }
+        return (table << 10u) | (addr & 0x03ffu);
+    }
+
+    [[nodiscard]] static uint8_t palette_addr(uint16_t addr) noexcept {
+        // $3f10/$3f14/$3f18/$3f1c mirror the backdrop entries
+        auto index = addr & 0x1fu;
+        return (index & 0x13u) == 0x10u ? index & 0x0fu : index;
+    }
+
+    uint8_t fetch(uint16_t addr) const noexcept {
+        addr &= 0x3fffu;
+        if (addr < 0x2000)
+            return _cartridge->board().fetch_chr(addr);
+        if (addr < 0x3f00)
+            return _vram[nametable_addr(addr)];
+        return _palette[palette_addr(addr)];
+    }
+
+    void store(uint16_t addr, uint8_t data) noexcept {
+        addr &= 0x3fffu;
+        if (addr < 0x2000) {
+            _cartridge->board().store_chr(addr, data);
+            _chr_cache.invalidate(_cartridge->board(), addr);
+        } else if (addr < 0x3f00)
+            _vram[nametable_addr(addr)] = data;
+        else
+            _palette[palette_addr(addr)] = data & 0x3fu;
+    }
+
+    void vblank_start() noexcept {
+        _status |= status::vblank;
+        _frame++;
+        if (_ctrl & ctrl::nmi)
+            _nmi_edge = true;
+    }
+
+    void increment_y() noexcept {
+        if ((_v & 0x7000u) != 0x7000u) {
+            _v += 0x1000u;
+            return;
+        }
+
+        _v &= ~0x7000u;
+        int y = (_v & 0x03e0u) >> 5u;
+        if (y == 29) {
+            y = 0;
+            _v ^= 0x0800u;
+        } else if (y == 31) {
+            y = 0;
+        } else {
+            y++;
+        }
+        _v = (_v & ~0x03e0u) | (y << 5u);
+    }
+
+    void copy_x() noexcept {
+        _v = (_v & ~0x041fu) | (_t & 0x041fu);
+    }
+
+    void copy_y() noexcept {
+        _v = (_v & ~0x7be0u) | (_t & 0x7be0u);
+    }
+
+    // the next dot of the current scanline where something has to happen
+    [[nodiscard]] int next_stop() const noexcept {
+        bool visible = _scanline < height;
+
+        if ((_scanline == vblank_scanline || _scanline == prerender_scanline) && _dot < 1)
+            return 1;
+        if (visible && _dot < _sprite0_dot)
+            return _sprite0_dot;
+        if (visible || _scanline == prerender_scanline) {
+            if (_dot < 257)
+                return 257;
+            if (_dot < 260)
+                return 260;
+            if (_scanline == prerender_scanline && _dot < 280)
+                return 280;
+        }
+        return dots_per_scanline;
+    }
+
+    void event() noexcept {
+        if (_dot == _sprite0_dot) {
+            _status |= status::sprite0_hit;
+            _sprite0_dot = -1;
+        }
+
+        switch (_dot) {
+            case 1:
+                if (_scanline == vblank_scanline)
+                    vblank_start();
+                else if (_scanline == prerender_scanline)
+                    _status &= ~(status::vblank | status::sprite0_hit | status::overflow);
+                break;
+            case 257:
+                if (rendering()) {
+                    increment_y();
+                    copy_x();
+                }
+                break;
+            case 260:
+                if (rendering())
+                    _cartridge->board().scanline();
+                break;
+            case 280:
+                if (rendering())
+                    copy_y();
+                break;
+            case dots_per_scanline:
+                next_scanline();
+                break;
+            default:
+                break;
+        }
+    }
+
+    void next_scanline() noexcept {
+        _dot = 0;
+        _scanline++;
+        if (_scanline == scanlines_per_frame) {
+            _scanline = 0;
+            // the pre-render line is one dot shorter on odd frames when rendering
+            if ((_frame & 1u) && rendering())
+                _dot = 1;
+        }
+
+        if (_scanline < height)
+            render_scanline();
+    }
+
+    void render_background(std::array<uint8_t, width + 16> &line) noexcept {
+        uint16_t v = _v;
+        uint16_t table = (_ctrl & ctrl::background_table) ? 0x1000 : 0x0000;
+        auto fine_y = (v >> 12u) & 0x07u;
+
+        for (int tile = 0; tile < 33; tile++) {
+            auto index = _vram[nametable_addr(0x2000u | (v & 0x0fffu))];
+            auto attr = _vram[nametable_addr(0x23c0u | (v & 0x0c00u) | ((v >> 4u) & 0x38u) | ((v >> 2u) & 0x07u))];
+            uint64_t palette = ((attr >> (((v >> 4u) & 0x04u) | (v & 0x02u))) & 0x03u) << 2u;
+            auto row = _chr_cache.row(static_cast<uint16_t>(table + index * 16 + fine_y));
+            row |= opaque_pixels(row) * palette;
+            std::memcpy(&line[tile * 8], &row, sizeof(row));
+
+            if ((v & 0x001fu) == 31) {
+                v &= ~0x001fu;
+                v ^= 0x0400u;
+            } else {
+                v++;
+            }
+        }
+    }
+
+    // sprite pixels are 0x10 | palette << 2 | color, bit 7 flags sprite 0 and bit 6 the back priority.
+    // Return true when sprite 0 is on the line.
+    bool render_sprites(std::array<uint8_t, width> &line) noexcept {
+        int y = _scanline;
+        int sprite_height = (_ctrl & ctrl::sprite_16) ? 16 : 8;
+        int found = 0;
+        bool sprite0 = false;
+
+        for (int i = 0; i < 64; i++) {
+            auto sprite = &_oam[i * 4];
+            int row = y - sprite[0] - 1;
+            if (row < 0 || row >= sprite_height)
+                continue;
+            if (++found > 8) {
+                _status |= status::overflow;
+                break;
+            }
+            sprite0 |= i == 0;
+
+            auto tile = sprite[1];
+            auto attr = sprite[2];
+            if (attr & 0x80u)
+                row = sprite_height - 1 - row;
+
+            uint16_t addr;
+            if (sprite_height == 16) {
+                addr = ((tile & 0x01u) ? 0x1000 : 0x0000) + (tile & 0xfeu) * 16;
+                if (row >= 8) {
+                    addr += 16;
+                    row -= 8;
+                }
+            } else {
+                addr = ((_ctrl & ctrl::sprite_table) ? 0x1000 : 0x0000) + tile * 16;
+            }
+            addr += row;
+
+            // a horizontal flip is a byte swap of the expanded row
+            auto pattern = _chr_cache.row(addr);
+            if (attr & 0x40u)
+                pattern = __builtin_bswap64(pattern);
+            std::array<uint8_t, 8> pixels{};
+            std::memcpy(pixels.data(), &pattern, sizeof(pattern));
+            uint8_t flags = 0x10u | ((attr & 0x03u) << 2u) | ((attr & 0x20u) << 1u) | (i == 0 ? 0x80u : 0x00u);
+
+            for (int px = 0; px < 8; px++) {
+                int x = sprite[3] + px;
+                if (x >= width)
+                    break;
+                uint8_t color = pixels[px];
+                if (color && !(line[x] & 0x03u))
+                    line[x] = flags | color;
+            }
+        }
+        return sprite0;
+    }
+
+    void render_scanline() noexcept {
+        auto out = &_framebuffer[_scanline * width];
+        uint8_t gray = (_mask & mask::grayscale) ? 0x30 : 0x3f;
+
+        if (!rendering()) {
+            std::fill(out, out + width, _palette[0] & gray);
+            return;
+        }
+
+        _chr_cache.sync(_cartridge->board());
+
+        std::array<uint8_t, width + 16> background_line{};
+        std::array<uint8_t, width> sprites{};
+        bool sprite0 = false;
+        if (_mask & mask::background)
+            render_background(background_line);
+        if (_mask & mask::sprites)
+            sprite0 = render_sprites(sprites);
+
+        auto background = &background_line[_x];
+        if (!(_mask & mask::background_left))
+            std::fill(background, background + 8, 0);
+        if (!(_mask & mask::sprites_left))
+            std::fill(sprites.begin(), sprites.begin() + 8, 0);
+
+        if (sprite0 && _sprite0_dot < 0 && !(_status & status::sprite0_hit)) {
+            for (int x = 0; x < width - 1; x++) {
+                if ((background[x] & 0x03u) && (sprites[x] & 0x03u) && (sprites[x] & 0x80u)) {
+                    _sprite0_dot = x + 1;
+                    break;
+                }
+            }
+        }
+
+        _kernels.compose(background, sprites.data(), _palette.data(), gray, width, out);
+    }
+
+    friend ppu;
+};
+
+ppu::ppu(cartridge::cartridge &cartridge) : _impl(std::make_unique<ppu_impl>()) {
+    _impl->_cartridge = &cartridge;
+}
+
+ppu::~ppu() = default;
+
+void ppu::reset() {
+    auto &impl = *_impl;
+    impl._ctrl = 0;
+    impl._mask = 0;
+    impl._w = false;
+    impl._read_buffer = 0;
+    impl._scanline = 0;
+    impl._dot = 0;
+    impl._sprite0_dot = -1;
+    impl._nmi_edge = false;
+}
+
+uint8_t ppu::fetch_register(uint16_t addr) {
+    auto &impl = *_impl;
+
+    switch (addr & 0x07u) {
+        case 2:
+            impl._open_bus = (impl._status & 0xe0u) | (impl._open_bus & 0x1fu);
+            impl._status &= ~status::vblank;
+            impl._w = false;
+            break;
+        case 4:
+            impl._open_bus = impl._oam[impl._oam_addr];
+            break;
+        case 7: {
+            auto vaddr = impl._v & 0x3fffu;
+            // palette reads are not delayed, the buffer gets the nametable byte underneath
+            if (vaddr >= 0x3f00) {
+                impl._open_bus = impl.fetch(vaddr);
+                impl._read_buffer = impl.fetch(vaddr - 0x1000);
+            } else {
+                impl._open_bus = impl._read_buffer;
+                impl._read_buffer = impl.fetch(vaddr);
+            }
+            impl._v += (impl._ctrl & ctrl::increment_32) ? 32 : 1;
+            break;
+        }
+        default:
+            break;
+    }
+
+    return impl._open_bus;
+}
+
+void ppu::store_register(uint16_t addr, uint8_t data) {
+    auto &impl = *_impl;
+    impl._open_bus = data;
+
+    switch (addr & 0x07u) {
+        case 0:
+            // enabling nmi during vblank raises the line immediately
+            if (!(impl._ctrl & ctrl::nmi) && (data & ctrl::nmi) && (impl._status & status::vblank))
+                impl._nmi_edge = true;
+            impl._ctrl = data;
+            impl._t = (impl._t & ~0x0c00u) | ((data & 0x03u) << 10u);
+            break;
+        case 1:
+            impl._mask = data;
+            break;
+        case 3:
+            impl._oam_addr = data;
+            break;
+        case 4:
+            impl._oam[impl._oam_addr++] = data;
+            break;
+        case 5:
+            if (!impl._w) {
+                impl._t = (impl._t & ~0x001fu) | (data >> 3u);
+                impl._x = data & 0x07u;
+            } else {
+                impl._t = (impl._t & ~0x73e0u) | ((data & 0x07u) << 12u) | ((data & 0xf8u) << 2u);
+            }
+            impl._w = !impl._w;
+            break;
+        case 6:
+            if (!impl._w) {
+                impl._t = (impl._t & 0x00ffu) | ((data & 0x3fu) << 8u);
+            } else {
+                impl._t = (impl._t & 0xff00u) | data;
+                impl._v = impl._t;
+            }
+            impl._w = !impl._w;
+            break;
+        case 7:
+            impl.store(impl._v, data);
+            impl._v += (impl._ctrl & ctrl::increment_32) ? 32 : 1;
+            break;
+        default:
+            break;
+    }
+}
+
+void ppu::write_oam(std::span<uint8_t const, 0x100> data) noexcept {
+    auto &impl = *_impl;
+    // the oam address wraps around and ends up where it started
+    std::size_t first = impl._oam.size() - impl._oam_addr;
+    std::memcpy(&impl._oam[impl._oam_addr], data.data(), first);
+    std::memcpy(impl._oam.data(), data.data() + first, impl._oam_addr);
+}
+
+void ppu::run(uint64_t dots) {
+    auto &impl = *_impl;
+
+    while (dots) {
+        auto stop = impl.next_stop();
+        auto step = std::min<uint64_t>(dots, stop - impl._dot);
+        impl._dot += static_cast<int>(step);
+        dots -= step;
+        if (impl._dot == stop)
+            impl.event();
+    }
+}
+
+bool ppu::poll_nmi() noexcept {
+    return std::exchange(_impl->_nmi_edge, false);
+}
+
+uint64_t ppu::dots_to_nmi() const noexcept {
+    auto const &impl = *_impl;
+    if (impl._nmi_edge)
+        return 0;
+    if (!(impl._ctrl & ctrl::nmi))
+        return std::numeric_limits<uint64_t>::max();
+    return dots_to_vblank();
+}
+
+uint64_t ppu::dots_to_vblank() const noexcept {
+    auto const &impl = *_impl;
+    auto now = impl._scanline * dots_per_scanline + impl._dot;
+    auto edge = vblank_scanline * dots_per_scanline + 1;
+    if (now < edge)
+        return edge - now;
+    // the pre-render line may be a dot shorter
+    return scanlines_per_frame * dots_per_scanline - now + edge - 1;
+}
+
+uint64_t ppu::dots_to_irq() const noexcept {
+    auto const &impl = *_impl;
+    auto count = impl._cartridge->board().scanlines_to_irq();
+    if (count == 0)
+        return 0;
+    if (count == std::numeric_limits<uint32_t>::max() || !impl.rendering())
+        return std::numeric_limits<uint64_t>::max();
+
+    // the counter is clocked at dot 260 of the visible lines and of the pre-render line
+    constexpr uint64_t clocks_per_frame{height + 1};
+    uint64_t next;
+    if (impl._scanline < height)
+        next = impl._scanline + (impl._dot >= 260 ? 1 : 0);
+    else if (impl._scanline < prerender_scanline)
+        next = height;
+    else
+        next = height + (impl._dot >= 260 ? 1 : 0);
+
+    auto target = next + count - 1;
+    auto frames = target / clocks_per_frame;
+    auto index = target % clocks_per_frame;
+    auto line = index == height ? prerender_scanline : static_cast<int>(index);
+    uint64_t now = impl._scanline * dots_per_scanline + impl._dot;
+    uint64_t edge = frames * scanlines_per_frame * dots_per_scanline + line * dots_per_scanline + 260;
+    // every pre-render line crossed may be a dot shorter
+    return edge - now - frames;
+}
+
+uint64_t ppu::frame() const noexcept {
+    return _impl->_frame;
+}
+
+int ppu::scanline() const noexcept {
+    return _impl->_scanline;
+}
+
+int ppu::dot() const noexcept {
+    return _impl->_dot;
+}
+
+std::span<uint8_t const> ppu::framebuffer() const noexcept {
+    return _impl->_framebuffer;
+}
+
+void ppu::save(ppu_state &state) const noexcept {
+    auto const &impl = *_impl;
+    state.ctrl = impl._ctrl;
+    state.mask = impl._mask;
+    state.status = impl._status;
+    state.oam_addr = impl._oam_addr;
+    state.read_buffer = impl._read_buffer;
+    state.open_bus = impl._open_bus;
+    state.x = impl._x;
+    state.w = impl._w;
+    state.v = impl._v;
+    state.t = impl._t;
+    state.scanline = static_cast<int16_t>(impl._scanline);
+    state.dot = static_cast<int16_t>(impl._dot);
+    state.sprite0_dot = static_cast<int16_t>(impl._sprite0_dot);
+    state.nmi_edge = impl._nmi_edge;
+    state.frame = impl._frame;
+    state.vram = impl._vram;
+    state.palette = impl._palette;
+    state.oam = impl._oam;
+}
+
+void ppu::load(ppu_state const &state) noexcept {
+    auto &impl = *_impl;
+    impl._ctrl = state.ctrl;
+    impl._mask = state.mask;
+    impl._status = state.status;
+    impl._oam_addr = state.oam_addr;
+    impl._read_buffer = state.read_buffer;
+    impl._open_bus = state.open_bus;
+    impl._x = state.x;
+    impl._w = state.w;
+    impl._v = state.v;
+    impl._t = state.t;
+    impl._scanline = state.scanline;
+    impl._dot = state.dot;
+    impl._sprite0_dot = state.sprite0_dot;
+    impl._nmi_edge = state.nmi_edge;
+    impl._frame = state.frame;
+    impl._vram = state.vram;
+    impl._palette = state.palette;
+    impl._oam = state.oam;
+    impl._chr_cache.clear();
+}